@@ -0,0 +1,411 @@
+/*
+Copyright (c) 2013 Christian Glöckner <cgloeckner@freenet.de>
+
+This file is part of the networking module:
+    https://github.com/cgloeckner/networking
+
+It offers a tcp-based server-client framework for games and other software.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+
+#include <net/server.hpp>
+#include <net/client.hpp>
+
+#include "protocol.hpp"
+
+/// Benchmark settings
+struct Settings {
+    std::uint16_t port;
+    std::size_t clients;
+    std::size_t messages;
+    std::size_t size;
+    std::size_t window;
+    std::size_t group;
+    std::size_t handlers;
+    std::size_t networkers;
+    std::size_t timeout;
+    std::vector<std::string> workloads;
+
+    Settings()
+        : port(42420)
+        , clients(16)
+        , messages(1000)
+        , size(64)
+        , window(8)
+        , group(4)
+        , handlers(1)
+        , networkers(1)
+        , timeout(60)
+        , workloads({"unicast", "broadcast", "group"}) {
+    }
+};
+
+class BenchServer: public net::Server<BenchProtocol> {
+
+    public:
+        std::atomic<std::size_t> joined;
+
+        BenchServer()
+            : net::Server<BenchProtocol>()
+            , joined(0) {
+            // BenchProtocol resets recycled objects by clear
+            this->setPoolSize(1024);
+            this->attach(commands::ECHO, [this](BenchProtocol & data) {
+                this->push(data, data.client);
+            });
+            this->attach(commands::BROADCAST, [this](BenchProtocol & data) {
+                this->push(data);
+            });
+            this->attach(commands::GROUP, [this](BenchProtocol & data) {
+                this->pushGroup(data, data.group);
+            });
+            this->attach(commands::JOIN, [this](BenchProtocol & data) {
+                this->group(data.client, data.group);
+                this->joined++;
+            });
+        }
+
+        void fallback(BenchProtocol & data) {
+            std::cerr << "Unexpected command #" << data.command << std::endl;
+        }
+
+};
+
+/// Synthetic client sending requests in a closed loop
+/**
+ * The client keeps up to `window` requests in flight: each of its own
+ *  requests that comes back triggers the next one, until all messages were
+ *  sent. Every received object is counted and its latency is recorded.
+ */
+class BenchClient: public net::Client<BenchProtocol> {
+
+    protected:
+        net::CommandID command;
+        std::size_t messages;
+        std::string payload;
+        std::atomic<std::size_t> sent;
+        std::mutex mutex;
+
+        void received(BenchProtocol & data) {
+            auto latency = now() - data.stamp;
+            this->mutex.lock();
+            this->latencies.push_back(latency);
+            this->mutex.unlock();
+            if (data.sender == this->id) {
+                this->request();
+            }
+            this->delivered++;
+        }
+
+        void request() {
+            if (this->sent.fetch_add(1) >= this->messages) {
+                return;
+            }
+            BenchProtocol data;
+            data.command = this->command;
+            data.sender = this->id;
+            data.group = this->group;
+            data.payload = this->payload;
+            data.stamp = now();
+            this->push(std::move(data));
+        }
+
+    public:
+        std::uint32_t group;
+        std::atomic<std::size_t> delivered;
+        std::vector<std::uint64_t> latencies;
+
+        BenchClient()
+            : net::Client<BenchProtocol>()
+            , command(commands::ECHO)
+            , messages(0)
+            , sent(0)
+            , group(0)
+            , delivered(0) {
+            auto callback = [this](BenchProtocol & data) {
+                this->received(data);
+            };
+            this->attach(commands::ECHO, callback);
+            this->attach(commands::BROADCAST, callback);
+            this->attach(commands::GROUP, callback);
+        }
+
+        void fallback(BenchProtocol & data) {
+            std::cerr << "Unexpected command #" << data.command << std::endl;
+        }
+
+        void join() {
+            BenchProtocol data;
+            data.command = commands::JOIN;
+            data.group = this->group;
+            this->push(std::move(data));
+        }
+
+        void prepare(net::CommandID const command, std::size_t const messages,
+                     std::size_t const size) {
+            this->command = command;
+            this->messages = messages;
+            this->payload.assign(size, 'x');
+            this->sent = 0;
+            this->delivered = 0;
+            this->mutex.lock();
+            this->latencies.clear();
+            this->latencies.reserve(messages);
+            this->mutex.unlock();
+        }
+
+        void start(std::size_t const window) {
+            for (std::size_t i = 0; i < window; i++) {
+                this->request();
+            }
+        }
+
+        std::vector<std::uint64_t> getLatencies() {
+            this->mutex.lock();
+            auto copy = this->latencies;
+            this->mutex.unlock();
+            return copy;
+        }
+
+};
+
+/// Returns the given percentile of sorted samples in microseconds
+double percentile(std::vector<std::uint64_t> const & sorted, double const q) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    auto index = std::min(sorted.size() - 1, std::size_t(q * sorted.size()));
+    return sorted[index] / 1000.0;
+}
+
+/// Run a workload and print its results as a JSON line
+bool run(Settings const & settings, std::string const & workload,
+         BenchServer & server,
+         std::vector<std::unique_ptr<BenchClient>> & clients) {
+    net::CommandID command;
+    if (workload == "unicast") {
+        command = commands::ECHO;
+    } else if (workload == "broadcast") {
+        command = commands::BROADCAST;
+    } else if (workload == "group") {
+        command = commands::GROUP;
+    } else {
+        std::cerr << "Unknown workload " << workload << std::endl;
+        return false;
+    }
+    // Number of objects each client's requests are delivered to
+    std::vector<std::size_t> members(clients.size(), 0);
+    for (auto & client: clients) {
+        members[client->group]++;
+    }
+    std::size_t expected = 0;
+    for (auto & client: clients) {
+        client->prepare(command, settings.messages, settings.size);
+        if (command == commands::ECHO) {
+            expected += settings.messages;
+        } else if (command == commands::BROADCAST) {
+            expected += settings.messages * clients.size();
+        } else {
+            expected += settings.messages * members[client->group];
+        }
+    }
+    // Size of each object on the wire
+    BenchProtocol sample;
+    sample.command = command;
+    sample.payload.assign(settings.size, 'x');
+    sf::Packet packet;
+    sample.pack(packet);
+    auto frame = packet.getDataSize() + 4;
+
+    server.resetLatency();
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::seconds(settings.timeout);
+    for (auto & client: clients) {
+        client->start(settings.window);
+    }
+    std::size_t delivered = 0;
+    while (true) {
+        delivered = 0;
+        for (auto & client: clients) {
+            delivered += client->delivered;
+        }
+        if (delivered >= expected
+            || std::chrono::steady_clock::now() >= deadline) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    std::vector<std::uint64_t> latencies;
+    latencies.reserve(delivered);
+    for (auto & client: clients) {
+        auto samples = client->getLatencies();
+        latencies.insert(latencies.end(), samples.begin(), samples.end());
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    std::cout << "{\"workload\": \"" << workload << "\""
+              << ", \"clients\": " << clients.size()
+              << ", \"messages\": " << settings.messages
+              << ", \"size\": " << settings.size
+              << ", \"window\": " << settings.window
+              << ", \"group\": " << settings.group
+              << ", \"handlers\": " << settings.handlers
+              << ", \"networkers\": " << settings.networkers
+              << ", \"delivered\": " << delivered
+              << ", \"expected\": " << expected
+              << ", \"seconds\": " << seconds
+              << ", \"msgs_per_sec\": " << delivered / seconds
+              << ", \"bytes_per_sec\": " << delivered * frame / seconds
+              << ", \"p50_us\": " << percentile(latencies, 0.5)
+              << ", \"p99_us\": " << percentile(latencies, 0.99)
+              << ", \"p999_us\": " << percentile(latencies, 0.999)
+              << ", \"max_us\": " << percentile(latencies, 1.0);
+#ifdef NET_PROFILE
+    // Server-side latencies per pipeline stage
+    std::pair<char const *, net::Stage> const stages[] = {
+        {"receive", net::Stage::Receive}, {"incoming", net::Stage::Incoming},
+        {"handler", net::Stage::Handler}, {"outgoing", net::Stage::Outgoing}
+    };
+    for (auto const & stage: stages) {
+        auto const & histogram = server.getLatency(stage.second);
+        std::cout << ", \"server_" << stage.first << "_p50_us\": "
+                  << histogram.percentile(0.5) / 1000.0
+                  << ", \"server_" << stage.first << "_p99_us\": "
+                  << histogram.percentile(0.99) / 1000.0;
+    }
+#endif
+    std::cout << "}" << std::endl;
+    return (delivered == expected);
+}
+
+void usage(char const * name) {
+    Settings defaults;
+    std::cout << "Usage: " << name << " [options]" << std::endl
+              << "  --port N        port on loopback (" << defaults.port
+              << ")" << std::endl
+              << "  --clients N     synthetic clients (" << defaults.clients
+              << ")" << std::endl
+              << "  --messages N    requests per client (" << defaults.messages
+              << ")" << std::endl
+              << "  --size N        payload bytes (" << defaults.size << ")"
+              << std::endl
+              << "  --window N      requests in flight per client ("
+              << defaults.window << ")" << std::endl
+              << "  --group N       clients per group (" << defaults.group
+              << ")" << std::endl
+              << "  --handlers N    server handler threads ("
+              << defaults.handlers << ")" << std::endl
+              << "  --networkers N  server network threads ("
+              << defaults.networkers << ")" << std::endl
+              << "  --timeout N     seconds per workload (" << defaults.timeout
+              << ")" << std::endl
+              << "  --workload W    unicast, broadcast or group (repeatable,"
+              << " default: all)" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    Settings settings;
+    bool custom = false;
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (option == "--help" || i + 1 >= argc) {
+            usage(argv[0]);
+            return (option == "--help") ? 0 : 1;
+        }
+        std::string value = argv[++i];
+        auto number = std::size_t(std::strtoul(value.c_str(), NULL, 10));
+        if (option == "--port") {
+            settings.port = std::uint16_t(number);
+        } else if (option == "--clients") {
+            settings.clients = number;
+        } else if (option == "--messages") {
+            settings.messages = number;
+        } else if (option == "--size") {
+            settings.size = number;
+        } else if (option == "--window") {
+            settings.window = number;
+        } else if (option == "--group") {
+            settings.group = number;
+        } else if (option == "--handlers") {
+            settings.handlers = number;
+        } else if (option == "--networkers") {
+            settings.networkers = number;
+        } else if (option == "--timeout") {
+            settings.timeout = number;
+        } else if (option == "--workload") {
+            if (!custom) {
+                settings.workloads.clear();
+                custom = true;
+            }
+            settings.workloads.push_back(value);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (settings.clients == 0 || settings.window == 0 || settings.group == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    BenchServer server;
+    server.setHandlers(settings.handlers);
+    server.setNetworkers(settings.networkers);
+    if (!server.start(settings.port)) {
+        std::cerr << "Cannot listen on port " << settings.port << std::endl;
+        return 1;
+    }
+    std::vector<std::unique_ptr<BenchClient>> clients;
+    for (std::size_t i = 0; i < settings.clients; i++) {
+        clients.emplace_back(new BenchClient());
+        clients.back()->group = std::uint32_t(i / settings.group);
+        if (!clients.back()->connect("127.0.0.1", settings.port)) {
+            std::cerr << "Cannot connect client #" << i << std::endl;
+            return 1;
+        }
+        clients.back()->join();
+    }
+    while (server.joined < settings.clients) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    bool complete = true;
+    for (auto const & workload: settings.workloads) {
+        complete = run(settings, workload, server, clients) && complete;
+    }
+
+    for (auto & client: clients) {
+        client->shutdown();
+    }
+    server.shutdown();
+    return complete ? 0 : 2;
+}
@@ -0,0 +1,253 @@
+/*
+Copyright (c) 2013 Christian Glöckner <cgloeckner@freenet.de>
+
+This file is part of the networking module:
+    https://github.com/cgloeckner/networking
+
+It offers a tcp-based server-client framework for games and other software.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+
+#include <net/common.hpp>
+#include <net/ringqueue.hpp>
+#include <net/callbacks.hpp>
+#include <net/frame.hpp>
+
+#include "../example/commands.hpp"
+
+/// Number of measured runs per benchmark (the median is reported)
+std::size_t repeat = 7;
+
+/// Prevents the compiler from optimizing unused results away
+std::atomic<std::uint64_t> sink(0);
+
+/// Run a benchmark and print the nanoseconds per operation as a JSON line
+/**
+ * The function performs `ops` operations and returns the elapsed time in
+ *  nanoseconds. It is run once for warm-up and then `repeat` times.
+ *  @param name: benchmark name
+ *  @param params: JSON fields describing the variant
+ *  @param ops: number of operations per run
+ *  @param function: benchmark run
+ */
+template <typename Function>
+void measure(std::string const & name, std::string const & params,
+             std::size_t const ops, Function function) {
+    function();
+    std::vector<double> samples;
+    for (std::size_t i = 0; i < repeat; i++) {
+        samples.push_back(double(function()) / ops);
+    }
+    std::sort(samples.begin(), samples.end());
+    auto median = samples[samples.size() / 2];
+    std::cout << "{\"benchmark\": \"" << name << "\", " << params
+              << ", \"ops\": " << ops
+              << ", \"median_ns\": " << median
+              << ", \"min_ns\": " << samples.front()
+              << ", \"max_ns\": " << samples.back()
+              << ", \"ops_per_sec\": " << 1e9 / median
+              << "}" << std::endl;
+}
+
+/// Returns the nanoseconds elapsed since the given time point
+inline std::uint64_t elapsed(std::chrono::steady_clock::time_point start) {
+    return std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+}
+
+// ----------------------------------------------------------------------------
+
+/// Push `items` objects by `producers` threads and pop them by one consumer
+template <template <typename> class Queue>
+void benchQueue(std::string const & name, std::size_t const producers,
+                std::size_t const items) {
+    auto run = [producers, items]() {
+        Queue<std::uint64_t> queue;
+        std::atomic<bool> go(false);
+        std::vector<std::thread> threads;
+        for (std::size_t p = 0; p < producers; p++) {
+            threads.emplace_back([&queue, &go, p, producers, items]() {
+                while (!go) {
+                    std::this_thread::yield();
+                }
+                for (std::size_t i = p; i < items; i += producers) {
+                    queue.push(std::uint64_t(i));
+                }
+            });
+        }
+        std::vector<std::uint64_t> batch;
+        std::uint64_t sum = 0;
+        std::size_t popped = 0;
+        auto start = std::chrono::steady_clock::now();
+        go = true;
+        while (popped < items) {
+            batch.clear();
+            popped += queue.waitPop(batch, 256);
+            for (auto value: batch) {
+                sum += value;
+            }
+        }
+        auto ns = elapsed(start);
+        for (auto & thread: threads) {
+            thread.join();
+        }
+        sink += sum;
+        return ns;
+    };
+    measure("queue", "\"queue\": \"" + name + "\", \"producers\": "
+            + std::to_string(producers), items, run);
+}
+
+// ----------------------------------------------------------------------------
+
+class Dispatcher: public net::CallbackManager<net::CommandID, std::uint64_t &> {
+
+    protected:
+        void fallback(std::uint64_t & value) {
+            value = 0;
+        }
+
+    public:
+        Dispatcher(std::size_t const commands) {
+            for (std::size_t i = 0; i < commands; i++) {
+                this->attach(net::CommandID(i), [i](std::uint64_t & value) {
+                    value += i;
+                });
+            }
+        }
+
+};
+
+/// Trigger randomly chosen commands out of `commands` registered ones
+void benchDispatch(std::size_t const commands, std::size_t const calls) {
+    Dispatcher dispatcher(commands);
+    // Precomputed sequence, so the generator is not measured
+    std::vector<net::CommandID> sequence(4096);
+    std::uint32_t state = 12345;
+    for (auto & ident: sequence) {
+        state = state * 1664525u + 1013904223u;
+        ident = net::CommandID((state >> 8) % commands);
+    }
+    auto run = [&dispatcher, &sequence, calls]() {
+        std::uint64_t value = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < calls; i++) {
+            dispatcher.trigger(sequence[i & 4095], value);
+        }
+        auto ns = elapsed(start);
+        sink += value;
+        return ns;
+    };
+    measure("dispatch", "\"commands\": " + std::to_string(commands), calls,
+            run);
+}
+
+// ----------------------------------------------------------------------------
+
+/// Returns a sample object of the given command
+ChatProtocol sample(net::CommandID const command) {
+    ChatProtocol object;
+    object.command = command;
+    object.username = "player";
+    object.userid = 42;
+    object.success = true;
+    object.add_user = true;
+    object.text = std::string(64, 'x');
+    return object;
+}
+
+/// Encode objects into frames (as the server does once per push)
+void benchEncode(net::CommandID const command, std::size_t const objects) {
+    auto object = sample(command);
+    auto run = [&object, objects]() {
+        std::size_t bytes = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < objects; i++) {
+            bytes += net::utils::encode(object)->size();
+        }
+        auto ns = elapsed(start);
+        sink += bytes;
+        return ns;
+    };
+    measure("encode", "\"command\": " + std::to_string(command), objects, run);
+}
+
+/// Decode received frames (as server and client do per received object)
+void benchDecode(net::CommandID const command, std::size_t const objects) {
+    auto object = sample(command);
+    auto frame = net::utils::encode(object);
+    auto run = [&frame, objects]() {
+        ChatProtocol target;
+        sf::Packet packet;
+        std::size_t decoded = 0;
+        auto size = frame->size() - net::utils::Frame::HEADER;
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < objects; i++) {
+            decoded += target.decode(frame->data(), size, packet);
+        }
+        auto ns = elapsed(start);
+        sink += decoded;
+        return ns;
+    };
+    measure("decode", "\"command\": " + std::to_string(command), objects, run);
+}
+
+// ----------------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+    // Optional scale factor for the number of operations
+    std::size_t scale = 1;
+    if (argc > 1) {
+        scale = std::max<std::size_t>(1, std::strtoul(argv[1], NULL, 10));
+    }
+    if (argc > 2) {
+        repeat = std::max<std::size_t>(1, std::strtoul(argv[2], NULL, 10));
+    }
+    std::size_t const items = 1000000 * scale;
+    std::size_t cores = std::max(2u, std::thread::hardware_concurrency());
+    // One core is left for the consumer
+
+    for (std::size_t producers = 1; producers < cores; producers *= 2) {
+        benchQueue<net::utils::SyncQueue>("SyncQueue", producers, items);
+        benchQueue<net::utils::MpscQueue>("MpscQueue", producers, items);
+    }
+    benchQueue<net::utils::SpscQueue>("SpscQueue", 1, items);
+
+    for (std::size_t commands = 1; commands <= 1024; commands *= 4) {
+        benchDispatch(commands, 10 * items);
+    }
+
+    for (net::CommandID command = commands::LOGIN_REQUEST;
+         command <= commands::USERLIST_UPDATE; command++) {
+        benchEncode(command, items);
+        benchDecode(command, items);
+    }
+
+    return (sink.load() != 0) ? 0 : 1;
+}
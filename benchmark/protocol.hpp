@@ -0,0 +1,106 @@
+/*
+Copyright (c) 2013 Christian Glöckner <cgloeckner@freenet.de>
+
+This file is part of the networking module:
+    https://github.com/cgloeckner/networking
+
+It offers a tcp-based server-client framework for games and other software.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#ifndef BENCHMARK_PROTOCOL_HPP_INCLUDED
+#define BENCHMARK_PROTOCOL_HPP_INCLUDED
+
+#include <chrono>
+#include <string>
+#include <cstdint>
+
+#include <SFML/Network.hpp>
+
+#include <net/common.hpp>
+
+namespace commands {
+
+    /// Echo back to the sender
+    const net::CommandID ECHO      = 1;
+    /// Push to all clients
+    const net::CommandID BROADCAST = 2;
+    /// Push to the sender's group
+    const net::CommandID GROUP     = 3;
+    /// Join a group
+    const net::CommandID JOIN      = 4;
+
+}
+
+/// Returns a timestamp in nanoseconds (comparable within the process)
+inline std::uint64_t now() {
+    return std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+class BenchProtocol: public net::BaseProtocol {
+
+    public:
+        BenchProtocol()
+            : net::BaseProtocol()
+            , sender(0)
+            , group(0)
+            , stamp(0) {
+        }
+
+        void clear() {
+            net::BaseProtocol::clear();
+            this->sender = 0;
+            this->group = 0;
+            this->stamp = 0;
+            this->payload.clear();
+        }
+
+        bool pack(sf::Packet & packet) {
+            // The timestamp is split, because not all SFML versions support
+            // 64-bit integers
+            packet << this->command << this->sender << this->group
+                   << sf::Uint32(this->stamp >> 32) << sf::Uint32(this->stamp)
+                   << this->payload;
+            return true;
+        }
+
+        bool unpack(sf::Packet & packet) {
+            sf::Uint32 high = 0, low = 0;
+            if (!(packet >> this->command >> this->sender >> this->group
+                         >> high >> low >> this->payload)) {
+                return false;
+            }
+            this->stamp = (std::uint64_t(high) << 32) | low;
+            return true;
+        }
+
+        /// Client that sent the request
+        net::ClientID sender;
+        /// Group of the sender
+        std::uint32_t group;
+        /// Time the request was sent (see `now`)
+        std::uint64_t stamp;
+        /// Filling bytes
+        std::string payload;
+};
+
+#endif // BENCHMARK_PROTOCOL_HPP_INCLUDED
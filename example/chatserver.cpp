@@ -41,7 +41,7 @@ ChatServer::ChatServer(const std::uint16_t port)
 }
 
 ChatServer::~ChatServer() {
-    this->listener.close();
+    this->disconnect();
     std::cout << "Server stopped" << std::endl;
 }
 
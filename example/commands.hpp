@@ -50,9 +50,18 @@ namespace commands {
 class ChatProtocol: public net::BaseProtocol {
 
     public:
-        bool send(sf::TcpSocket & socket) {
+        void clear() {
+            // Reset recycled object
+            net::BaseProtocol::clear();
+            this->username.clear();
+            this->userid = 0;
+            this->success = false;
+            this->text.clear();
+            this->add_user = false;
+        }
+
+        bool pack(sf::Packet & packet) {
             // Pack data
-            sf::Packet packet;
             packet << this->command;
             switch (this->command) {
             
@@ -85,23 +94,10 @@ class ChatProtocol: public net::BaseProtocol {
                     break;
                     
             }
-            // Send packet
-            auto status = socket.send(packet);
-            if (status != sf::Socket::Done) {
-                std::cerr << "Error while sending #" << this->command
-                          << std::endl << std::flush;
-                return false;
-            }
             return true;
         }
         
-        bool receive(sf::TcpSocket & socket) {
-            // Receive packet
-            sf::Packet packet;
-            auto status = socket.receive(packet);
-            if (status != sf::Socket::Done) {
-                return false;
-            }
+        bool unpack(sf::Packet & packet) {
             // Obtain data
             if (packet >> this->command) {
                 bool success = false;
@@ -0,0 +1,287 @@
+/*
+Copyright (c) 2013 Christian Glöckner <cgloeckner@freenet.de>
+
+This file is part of the networking module:
+    https://github.com/cgloeckner/networking
+
+It offers a tcp-based server-client framework for games and other software.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#ifndef NET_BLOCKLIST_INCLUDE_GUARD
+#define NET_BLOCKLIST_INCLUDE_GUARD
+
+#include <set>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+
+#include <SFML/Network.hpp>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <arpa/inet.h>
+#elif defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#endif
+
+namespace net {
+
+    namespace utils {
+
+        /// Binary IPv6 address (IPv4 addresses are mapped to ::ffff:a.b.c.d)
+        struct Address {
+            /// upper 64 bits
+            std::uint64_t high;
+            /// lower 64 bits
+            std::uint64_t low;
+
+            Address(std::uint64_t const high = 0, std::uint64_t const low = 0)
+                : high(high)
+                , low(low) {
+            }
+
+            /// Create an IPv4-mapped address
+            static inline Address fromIPv4(std::uint32_t const ip) {
+                return Address(0, 0xFFFF00000000ull | ip);
+            }
+
+            /// Create an address from 16 bytes in network byte order
+            static inline Address fromBytes(unsigned char const * bytes) {
+                Address address;
+                for (std::size_t i = 0; i < 8; i++) {
+                    address.high = (address.high << 8) | bytes[i];
+                    address.low = (address.low << 8) | bytes[i + 8];
+                }
+                return address;
+            }
+
+            /// Returns the following address (wrapping around)
+            inline Address next() const {
+                return Address(this->high + (this->low == ~0ull ? 1 : 0),
+                               this->low + 1);
+            }
+
+            inline bool operator<(Address const & other) const {
+                return (this->high < other.high
+                        || (this->high == other.high && this->low < other.low));
+            }
+
+            inline bool operator==(Address const & other) const {
+                return (this->high == other.high && this->low == other.low);
+            }
+        };
+
+        /// Range of addresses (both inclusive)
+        struct AddressRange {
+            /// lowest address
+            Address first;
+            /// highest address
+            Address last;
+
+            inline bool operator<(AddressRange const & other) const {
+                return (this->first < other.first
+                        || (this->first == other.first
+                            && this->last < other.last));
+            }
+        };
+
+        /// Parse an address or CIDR range
+        /**
+         * Accepts IPv4 and IPv6 addresses with an optional prefix length
+         *  (e.g. "10.0.0.0/8" or "2001:db8::/32"). Everything else is
+         *  resolved as a hostname to a single IPv4 address.
+         *  @param text: address, range or hostname
+         *  @param range: range to fill
+         *  @return false if the text is not valid
+         */
+        inline bool parseRange(std::string const & text, AddressRange & range) {
+            auto slash = text.find('/');
+            std::string host = text.substr(0, slash);
+            std::size_t bits;
+            Address address;
+            if (host.find(':') != std::string::npos) {
+#if defined(__unix__) || defined(__APPLE__) || defined(_WIN32)
+                unsigned char bytes[16];
+                if (inet_pton(AF_INET6, host.c_str(), bytes) != 1) {
+                    return false;
+                }
+                address = Address::fromBytes(bytes);
+                bits = 128;
+#else
+                return false;
+#endif
+            } else {
+                sf::IpAddress ip(host);
+                if (ip == sf::IpAddress::None) {
+                    return false;
+                }
+                address = Address::fromIPv4(ip.toInteger());
+                bits = 32;
+            }
+            std::size_t prefix = bits;
+            if (slash != std::string::npos) {
+                auto digits = text.substr(slash + 1);
+                char * end = NULL;
+                auto value = std::strtoul(digits.c_str(), &end, 10);
+                if (digits.empty() || *end != '\0' || value > bits) {
+                    return false;
+                }
+                prefix = value;
+            }
+            // Mapped IPv4 ranges are located behind a 96 bit prefix
+            prefix += 128 - bits;
+            // Mask all bits behind the prefix
+            std::uint64_t high_mask = (prefix >= 64) ? ~0ull
+                : (prefix == 0) ? 0ull : ~0ull << (64 - prefix);
+            std::uint64_t low_mask = (prefix <= 64) ? 0ull
+                : ~0ull << (128 - prefix);
+            range.first = Address(address.high & high_mask,
+                                  address.low & low_mask);
+            range.last = Address(address.high | ~high_mask,
+                                 address.low | ~low_mask);
+            return true;
+        }
+
+        /// Set of blocked addresses and ranges
+        /**
+         * Lookups binary-search a sorted table of merged, non-overlapping
+         *  ranges. The table is immutable once published and replaced as a
+         *  whole after each modification, so lookups do not lock the
+         *  blocklist. Modifications rebuild the table in linear time, so
+         *  large lists should be added at once (see `insert`).
+         */
+        class Blocklist {
+            public:
+                /// Sorted table of merged ranges
+                typedef std::vector<AddressRange> Table;
+
+            protected:
+                /// Blocked ranges as they were added
+                std::set<AddressRange> entries;
+                /// Published lookup table (accessed by std::atomic_load/store)
+                std::shared_ptr<Table const> table;
+                /// mutex for modifying the entries
+                std::mutex mutex;
+
+                /// Rebuild and publish the lookup table (mutex must be locked)
+                void publish() {
+                    std::shared_ptr<Table> next(new Table());
+                    for (auto entry = this->entries.begin();
+                         entry != this->entries.end(); entry++) {
+                        // Entries are sorted by their first address
+                        if (!next->empty()) {
+                            auto & back = next->back();
+                            if (!(back.last < entry->first)
+                                || back.last.next() == entry->first) {
+                                // Merge overlapping or adjacent ranges
+                                if (back.last < entry->last) {
+                                    back.last = entry->last;
+                                }
+                                continue;
+                            }
+                        }
+                        next->push_back(*entry);
+                    }
+                    std::shared_ptr<Table const> published(std::move(next));
+                    std::atomic_store(&this->table, published);
+                }
+
+            public:
+                /// Constructor
+                Blocklist()
+                    : table(new Table()) {
+                }
+
+                /// Add ranges (ignoring invalid ones)
+                /**
+                 *  @param begin: first address or range (as text)
+                 *  @param end: behind the last address or range
+                 *  @return number of valid ranges
+                 */
+                template <typename Iterator>
+                std::size_t insert(Iterator begin, Iterator end) {
+                    std::vector<AddressRange> ranges;
+                    for (auto text = begin; text != end; text++) {
+                        AddressRange range;
+                        if (parseRange(*text, range)) {
+                            ranges.push_back(range);
+                        }
+                    }
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    this->entries.insert(ranges.begin(), ranges.end());
+                    this->publish();
+                    return ranges.size();
+                }
+
+                /// Remove ranges that were added before
+                /**
+                 * Only exactly matching ranges are removed, so a single
+                 *  address inside a blocked range cannot be unblocked.
+                 *  @param begin: first address or range (as text)
+                 *  @param end: behind the last address or range
+                 *  @return number of valid ranges
+                 */
+                template <typename Iterator>
+                std::size_t erase(Iterator begin, Iterator end) {
+                    std::vector<AddressRange> ranges;
+                    for (auto text = begin; text != end; text++) {
+                        AddressRange range;
+                        if (parseRange(*text, range)) {
+                            ranges.push_back(range);
+                        }
+                    }
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    for (auto range = ranges.begin(); range != ranges.end();
+                         range++) {
+                        this->entries.erase(*range);
+                    }
+                    this->publish();
+                    return ranges.size();
+                }
+
+                /// Returns whether the address is blocked (without locking)
+                bool contains(Address const & address) const {
+                    auto table = std::atomic_load(&this->table);
+                    // First range starting behind the address
+                    auto next = std::upper_bound(table->begin(), table->end(),
+                        address, [](Address const & a, AddressRange const & r) {
+                            return a < r.first;
+                        });
+                    return (next != table->begin()
+                            && !((next - 1)->last < address));
+                }
+
+                /// Returns whether the IPv4 address is blocked
+                inline bool contains(sf::IpAddress const & ip) const {
+                    return this->contains(Address::fromIPv4(ip.toInteger()));
+                }
+        };
+
+    }
+
+}
+
+#endif // NET_BLOCKLIST_INCLUDE_GUARD
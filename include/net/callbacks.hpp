@@ -29,25 +29,231 @@ SOFTWARE.
 #ifndef NET_CALLBACKS_INCLUDE_GUARD
 #define NET_CALLBACKS_INCLUDE_GUARD
 
+#include <map>
+#include <new>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
 #include <net/common.hpp>
 
+/// Identifiers below this value are dispatched through a flat table
+#ifndef NET_DISPATCH_SIZE
+#define NET_DISPATCH_SIZE 256
+#endif
+
+/// Number of bytes a callback can store without allocating memory
+#ifndef NET_CALLBACK_STORAGE
+#define NET_CALLBACK_STORAGE 32
+#endif
+
 namespace net {
 
+    namespace utils {
+
+        /// Callable with small-buffer storage
+        /**
+         * This stores any callable that accepts a `Param`, like lambdas,
+         *  functors or function pointers. Callables up to
+         *  NET_CALLBACK_STORAGE bytes are stored inside the object, larger
+         *  ones are allocated. Callbacks are move-only.
+         */
+        template <typename Param>
+        class Callback {
+            protected:
+                /// memory for the callable (or a pointer to it)
+                typedef typename std::aligned_storage<NET_CALLBACK_STORAGE,
+                    alignof(std::max_align_t)>::type Storage;
+
+                /// Operations for callables stored inside the object
+                template <typename Function>
+                struct Local {
+                    static void invoke(Storage & storage, Param param) {
+                        (*reinterpret_cast<Function*>(&storage))(param);
+                    }
+                    static void manage(Storage & target, Storage * source) {
+                        if (source != NULL) {
+                            auto & other = *reinterpret_cast<Function*>(source);
+                            new (&target) Function(std::move(other));
+                            other.~Function();
+                        } else {
+                            reinterpret_cast<Function*>(&target)->~Function();
+                        }
+                    }
+                };
+
+                /// Operations for allocated callables
+                template <typename Function>
+                struct Remote {
+                    static void invoke(Storage & storage, Param param) {
+                        (**reinterpret_cast<Function**>(&storage))(param);
+                    }
+                    static void manage(Storage & target, Storage * source) {
+                        if (source != NULL) {
+                            *reinterpret_cast<Function**>(&target) =
+                                *reinterpret_cast<Function**>(source);
+                        } else {
+                            delete *reinterpret_cast<Function**>(&target);
+                        }
+                    }
+                };
+
+                Storage storage;
+                /// calls the stored callable
+                void (*invoker)(Storage & storage, Param param);
+                /// moves (source given) or destroys (no source) the callable
+                void (*manager)(Storage & target, Storage * source);
+
+                /// Construct a callable inside the storage
+                template <typename Function>
+                void store(Function && function, std::true_type) {
+                    typedef typename std::decay<Function>::type Type;
+                    new (&this->storage) Type(std::forward<Function>(function));
+                    this->invoker = &Local<Type>::invoke;
+                    this->manager = &Local<Type>::manage;
+                }
+                /// Allocate a callable
+                template <typename Function>
+                void store(Function && function, std::false_type) {
+                    typedef typename std::decay<Function>::type Type;
+                    *reinterpret_cast<Type**>(&this->storage) =
+                        new Type(std::forward<Function>(function));
+                    this->invoker = &Remote<Type>::invoke;
+                    this->manager = &Remote<Type>::manage;
+                }
+
+                /// Destroy the stored callable
+                void reset() {
+                    if (this->manager != NULL) {
+                        this->manager(this->storage, NULL);
+                    }
+                    this->invoker = NULL;
+                    this->manager = NULL;
+                }
+
+            public:
+                /// Constructor for an empty callback
+                Callback()
+                    : invoker(NULL)
+                    , manager(NULL) {
+                }
+
+                /// Constructor
+                /**
+                 *  @param function: callable accepting a `Param`
+                 */
+                template <typename Function, typename = typename
+                    std::enable_if<!std::is_same<typename std::decay<
+                        Function>::type, Callback>::value>::type>
+                Callback(Function && function) {
+                    typedef typename std::decay<Function>::type Type;
+                    typedef std::integral_constant<bool,
+                        sizeof(Type) <= sizeof(Storage)
+                        && alignof(Type) <= alignof(Storage)
+                        && std::is_nothrow_move_constructible<Type>::value
+                    > fits;
+                    this->store(std::forward<Function>(function), fits());
+                }
+
+                /// Move constructor
+                Callback(Callback && other)
+                    : invoker(other.invoker)
+                    , manager(other.manager) {
+                    if (this->manager != NULL) {
+                        this->manager(this->storage, &other.storage);
+                    }
+                    other.invoker = NULL;
+                    other.manager = NULL;
+                }
+
+                /// Move assignment
+                Callback & operator=(Callback && other) {
+                    if (this != &other) {
+                        this->reset();
+                        this->invoker = other.invoker;
+                        this->manager = other.manager;
+                        if (this->manager != NULL) {
+                            this->manager(this->storage, &other.storage);
+                        }
+                        other.invoker = NULL;
+                        other.manager = NULL;
+                    }
+                    return *this;
+                }
+
+                Callback(Callback const &) = delete;
+                Callback & operator=(Callback const &) = delete;
+
+                /// Destructor
+                ~Callback() {
+                    this->reset();
+                }
+
+                /// Returns whether a callable is stored
+                explicit operator bool() const {
+                    return (this->invoker != NULL);
+                }
+
+                /// Call the stored callable
+                inline void operator()(Param param) {
+                    this->invoker(this->storage, param);
+                }
+        };
+
+        /// Obtain the flat dispatch table's index of an identifier
+        /**
+         *  @param ident: identifier
+         *  @param index: set to the identifier's index
+         *  @return false if the identifier is not part of the table
+         */
+        template <typename Ident>
+        inline typename std::enable_if<std::is_integral<Ident>::value,
+                                       bool>::type
+        toIndex(Ident const ident, std::size_t & index) {
+            // negative identifiers are converted to huge values
+            if (std::uintmax_t(ident) >= NET_DISPATCH_SIZE) {
+                return false;
+            }
+            index = std::size_t(ident);
+            return true;
+        }
+        template <typename Ident>
+        inline typename std::enable_if<!std::is_integral<Ident>::value,
+                                       bool>::type
+        toIndex(Ident const &, std::size_t &) {
+            return false;
+        }
+
+    }
+
     /// CallbackManager
-    /** This template class is used to bind method pointers to some kind of
+    /** This template class is used to bind callables to some kind of
      *  identifier. So methods can be called by using a given identifier
-     *  and some data. Currently only one type of signature is allowed:
-     *      void Foo::bar(Param & data);
+     *  and some data. Callbacks can be methods of the derived class with
+     *  the signature
+     *      void Foo::bar(Param data);
+     *  or any other callable accepting a `Param`, e.g. lambdas.
+     *  Integral identifiers below NET_DISPATCH_SIZE are resolved by a flat
+     *  table, all other identifiers by a map.
      *
      *  Ident is the template type for the indentifiers (e.g. int)
      *  Param is the template type for the data, given to the methods
+     *
+     *  Server and client pass each received object by reference to exactly
+     *  one callback and recycle it afterwards. So callbacks own the object
+     *  while they run and may move its members (e.g. to relay a payload by
+     *  `push(std::move(...))`) instead of copying them.
      */
     template <typename Ident, typename Param>
     class CallbackManager {
 
         protected:
-            /// callback map
-            std::map<Ident, void (CallbackManager::*)(Param)> callbacks;
+            /// callbacks of dense identifiers, indexed by the identifier
+            std::vector<utils::Callback<Param>> table;
+            /// callbacks of all other identifiers
+            std::map<Ident, utils::Callback<Param>> callbacks;
             /// fallback handle
             virtual void fallback(Param param) = 0;
 
@@ -56,20 +262,40 @@ namespace net {
             CallbackManager() {
             }
 
-            /// register callback
-            template <typename Ptr>
-            void attach(Ident const ident, Ptr method) {
+            /// register a method of the derived class as callback
+            template <typename Owner>
+            void attach(Ident const ident, void (Owner::*method)(Param)) {
                 if (method == NULL) {
                     return;
                 }
-                // "fix" pointer type
-                auto tmp = reinterpret_cast<
-                    void (CallbackManager<Ident, Param>::*)(Param)
-                >(method);
-                this->callbacks[ident] = tmp;
+                auto owner = static_cast<Owner*>(this);
+                this->attach(ident, [owner, method](Param param) {
+                    (owner->*method)(param);
+                });
+            }
+            /// register any callable as callback
+            template <typename Function>
+            void attach(Ident const ident, Function function) {
+                utils::Callback<Param> callback(std::move(function));
+                std::size_t index;
+                if (utils::toIndex(ident, index)) {
+                    if (this->table.size() <= index) {
+                        this->table.resize(index + 1);
+                    }
+                    this->table[index] = std::move(callback);
+                } else {
+                    this->callbacks[ident] = std::move(callback);
+                }
             }
             /// unregister callback
             void detach(Ident const ident) {
+                std::size_t index;
+                if (utils::toIndex(ident, index)) {
+                    if (index < this->table.size()) {
+                        this->table[index] = utils::Callback<Param>();
+                    }
+                    return;
+                }
                 auto node = this->callbacks.find(ident);
                 if (node != this->callbacks.end()) {
                     this->callbacks.erase(node);
@@ -77,12 +303,18 @@ namespace net {
             }
             /// trigger callback
             void trigger(Ident const ident, Param param) {
-                auto node = this->callbacks.find(ident);
-                if (node != this->callbacks.end()) {
-                    auto cb = node->second;
-                    if (cb != NULL) {
-                        // execute callback;
-                        (this->*cb)(param);
+                std::size_t index;
+                if (utils::toIndex(ident, index)) {
+                    if (index < this->table.size() && this->table[index]) {
+                        // execute callback
+                        this->table[index](param);
+                        return;
+                    }
+                } else {
+                    auto node = this->callbacks.find(ident);
+                    if (node != this->callbacks.end() && node->second) {
+                        // execute callback
+                        node->second(param);
                         return;
                     }
                 }
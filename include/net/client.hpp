@@ -31,13 +31,34 @@ SOFTWARE.
 
 #include <set>
 #include <map>
+#include <deque>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <thread>
+#include <future>
+#include <functional>
+#include <system_error>
 
 #include <SFML/Network.hpp>
 
 #include <net/common.hpp>
 #include <net/callbacks.hpp>
+#include <net/poller.hpp>
+#include <net/socket.hpp>
+#include <net/frame.hpp>
+#include <net/pool.hpp>
+#include <net/profile.hpp>
+#include <net/stats.hpp>
+#include <net/session.hpp>
+#include <net/rpc.hpp>
+#include <net/compress.hpp>
+#include <net/coroutine.hpp>
+
+/// Time to wait for reconnecting and the session's answer (milliseconds)
+#ifndef NET_CONNECT_TIMEOUT
+#define NET_CONNECT_TIMEOUT 5000
+#endif
 
 namespace net {
 
@@ -45,31 +66,140 @@ namespace net {
     /**
      * The client provides communication with a given server. Sending and
      *  receiving data are handled in two seperate threads.
+     *  The queue implementation can be chosen by the second template
+     *  parameter: `utils::SyncQueue` (default, mutex-based) or one of the
+     *  lock-free queues from <net/ringqueue.hpp>. `utils::SpscQueue` can be
+     *  used if only a single thread pushes objects to the client.
+     *  Objects are encoded into frames when they are pushed (see
+     *  <net/frame.hpp>), so the network thread only writes them. A
+     *  resilient client (see `setReconnect`) reconnects after its link was
+     *  lost and resumes its session. Remote calls (see `call`) are
+     *  completed by the handler thread, too. If coroutines are supported
+     *  (see <net/coroutine.hpp>), objects, responses and timers can also be
+     *  awaited (see `receive`, `request` and `sleep`).
      */
-    template <typename Protocol>
+    template <typename Protocol,
+              template <typename> class Queue = utils::SyncQueue>
     class Client: public CallbackManager<CommandID, Protocol &> {
 
         protected:
             /// Threads
             std::thread networker;
             std::thread handler;
+            /// Recycled objects for received data
+            utils::ObjectPool<Protocol> pool;
+            /// Latencies of the message pipeline (see NET_PROFILE)
+            utils::Profile profile;
+            /// Sent and received objects and bytes
+            utils::LinkCounters traffic;
+            /// Callback execution times
+            utils::CommandTimer timer;
             /// Queues
-            utils::SyncQueue<Protocol> out;
-            utils::SyncQueue<Protocol> in;
+            Queue<utils::FramePtr> out;
+            Queue<utils::Pooled<Protocol>> in;
 
             /// Link to the server
             sf::TcpSocket link;
+            /// Address of the server
+            std::string host;
+            std::uint16_t port;
+            /// Received bytes that were not handled, yet
+            utils::FrameReader reader;
+            /// Packet reused for unpacking received objects
+            sf::Packet packet;
+            /// Compression of outgoing and decompression of received frames
+            utils::Compression compression;
+            utils::Inflater inflater;
+            /// Whether the server announced that it inflates frames
+            std::atomic<bool> inflates;
+            /// Frames taken from the queue that were not sent completely, yet
+            std::deque<utils::FramePtr> pending;
+            /// Number of bytes of the first pending frame that were sent
+            std::size_t offset;
+            /// Whether the network thread waits for the link to be writable
+            bool blocked;
+            /// Number of pushed objects that were not sent completely, yet
+            std::atomic<std::size_t> backlog;
             /// Client ID
             ClientID id;
+            /// Secret token of the session (0 = none)
+            std::uint64_t token;
+            /// Whether a session is maintained (see `setReconnect`)
+            bool resilient;
+            /// Maximum number of reconnection attempts (0 = unlimited)
+            std::size_t attempts;
+            /// Delays between reconnection attempts
+            utils::Backoff backoff;
+            /// Sent objects that were not acknowledged by the server, yet
+            utils::ReplayBuffer replay;
+            /// Whether the server answered the last session request
+            bool answered;
+            /// Whether the last session request resumed the session
+            bool resumed;
+            /// Whether the network thread is reconnecting
+            std::atomic<bool> reconnecting;
+            /// Whether the threads are being stopped
+            std::atomic<bool> stopping;
+            /// Whether the incomming queue was closed
+            std::atomic<bool> closed;
+            /// Remote calls waiting for their responses
+            utils::CallTable<Protocol> calls;
+#ifdef NET_USE_COROUTINES
+            /// Coroutines waiting for objects (keyed by command), responses
+            /// (keyed by request) or a time
+            utils::Scheduler<Protocol> coroutines;
+            /// Key of the last awaited request (above all commands)
+            std::atomic<std::uint64_t> requests;
+
+            /// Returns an awaiter that is resumed by the handler thread
+            utils::Awaiter<Protocol> await(
+                std::chrono::milliseconds const timeout);
+#endif
+#ifdef NET_USE_EPOLL
+            /// Readiness notification for the link and the outgoing queue
+            utils::Poller poller;
+#endif
+
+            /// Wake up the network thread
+            inline void wakeup() {
+#ifdef NET_USE_EPOLL
+                this->poller.wakeup();
+#endif
+            }
+
+            /// Returns whether the link is connected
+            inline bool isConnected() {
+                return (this->link.getRemoteAddress() != sf::IpAddress::None);
+            }
 
-            /// Send / Receive next data
-            bool sendNext();
+            /// Send as many frames as possible
+            bool flush();
+            /// Receive next data
             bool receiveNext();
+            /// Handle a control message received from the server
+            void receiveControl(char const * data, std::size_t size);
+            /// Connect to the server and start or resume the session
+            bool open(sf::Time const timeout);
+            /// Handle a broken link
+            void lost();
+            /// Connect again after the link was lost
+            bool reconnect();
 
             /// Threaded loops
             void network_loop();
             void handle_loop();
 
+            /// Called after the client reconnected
+            /**
+             * This is called by the network thread. If the session was not
+             *  resumed (e.g. because it expired), the client got a new ID
+             *  and lost its groups, so the application might need to login
+             *  again. Objects that were not sent before the link was lost
+             *  are sent to the new session, too.
+             *  @param resumed: whether the previous session was resumed
+             */
+            virtual void reconnected(bool const /*resumed*/) {}
+
         public:
             /// Constructor
             Client();
@@ -90,15 +220,17 @@ namespace net {
 
             /// Returns whether the client is online
             /**
+             * A resilient client is also online while it is reconnecting.
              *  @return true if connected
              */
             inline bool isOnline() {
-                return (this->link.getRemoteAddress() != sf::IpAddress::None);
+                return (this->isConnected() || this->reconnecting);
             }
 
             /// Disconnect safely
             /**
-             * This will wait for an empty outgoing queue and then disconnects.
+             * This will wait until all pushed objects were sent and then
+             *  disconnects.
              */
             virtual void shutdown();
 
@@ -111,149 +243,821 @@ namespace net {
 
             /// Push data for sending
             /**
+             * The data is packed immediately, so it can be changed afterwards.
              *  @param data: data
              */
             inline void push(Protocol & data){
-                this->out.push(data);
+                auto frame = utils::encode(data);
+                if (this->inflates) {
+                    frame = this->compression.apply(frame);
+                }
+                if (frame == NULL) {
+                    std::cerr << "Cannot pack #" << data.command << std::endl
+                              << std::flush;
+                    return;
+                }
+                this->backlog++;
+                this->out.push(std::move(frame));
+                this->wakeup();
+            }
+            /// Push temporary data for sending
+            /**
+             * The data is packed directly, so it is never copied.
+             *  @param data: data
+             */
+            inline void push(Protocol && data){
+                this->push(data);
+            }
+
+            /// Function receiving the response of a remote call (or NULL)
+            typedef typename utils::CallTable<Protocol>::Completion Completion;
+
+            /// Call a remote procedure
+            /**
+             * The request is sent like a pushed object and the server answers
+             *  it using `Server::reply`. Its response does not trigger the
+             *  attached callbacks but the completion, which is called by the
+             *  handler thread. Many calls can wait for their responses at
+             *  once; responses that arrive after their calls timed out are
+             *  dropped.
+             *  @param request: object to send
+             *  @param completion: called with the response, or with NULL if
+             *      the call timed out or the client was disconnected
+             *  @param timeout: maximum time to wait for the response
+             *  @return false if the client is offline, the completion is
+             *      empty or the request cannot be packed (the completion is
+             *      not called then)
+             */
+            bool call(Protocol & request, Completion completion,
+                      std::chrono::milliseconds const timeout
+                          = std::chrono::milliseconds(NET_CALL_TIMEOUT));
+
+            /// Call a remote procedure and wait for its response by a future
+            /**
+             * The future throws a `std::system_error` if the call fails:
+             *  `std::errc::timed_out` if no response arrived in time or the
+             *  client was disconnected, `std::errc::not_connected` if the
+             *  request was not sent at all. Do not wait for the future
+             *  inside a callback, because the handler thread completes it.
+             *  @param request: object to send
+             *  @param timeout: maximum time to wait for the response
+             *  @return future of the response
+             */
+            std::future<Protocol> call(Protocol & request,
+                                       std::chrono::milliseconds const timeout
+                                           = std::chrono::milliseconds(
+                                               NET_CALL_TIMEOUT));
+
+#ifdef NET_USE_COROUTINES
+            /// Wait for the next object with a command
+            /**
+             * The awaiting coroutine is resumed by the handler thread with a
+             *  copy of the object, which does not trigger the attached
+             *  callbacks then. If several coroutines wait for the same
+             *  command, they receive the objects in order.
+             *  @param command: command to wait for
+             *  @param timeout: maximum time to wait
+             *  @return awaitable yielding the object, or an empty optional if
+             *      it timed out or the client was disconnected
+             */
+            utils::Awaiter<Protocol> receive(CommandID const command,
+                std::chrono::milliseconds const timeout=utils::FOREVER);
+
+            /// Call a remote procedure and wait for its response
+            /**
+             * This works like `call`, but the awaiting coroutine is resumed
+             *  by the handler thread with the response. The request is sent
+             *  when the coroutine was suspended, so it must live until the
+             *  awaiting expression finished.
+             *  @param request: object to send
+             *  @param timeout: maximum time to wait for the response
+             *  @return awaitable yielding the response, or an empty optional
+             *      if the call failed or timed out
+             */
+            utils::Awaiter<Protocol> request(Protocol & request,
+                std::chrono::milliseconds const timeout
+                    = std::chrono::milliseconds(NET_CALL_TIMEOUT));
+
+            /// Wait for some time
+            /**
+             * The awaiting coroutine is resumed by the handler thread, so no
+             *  thread is blocked meanwhile.
+             *  @param duration: time to wait
+             *  @return awaitable yielding an empty optional
+             */
+            inline utils::Awaiter<Protocol> sleep(
+                std::chrono::milliseconds const duration) {
+                return this->await(duration);
+            }
+#endif
+
+            /// Set the number of recycled objects
+            /**
+             * Received objects are taken from a pool and returned to it after
+             *  they were handled, so their strings and vectors keep their
+             *  capacity. Recycled objects are reset by `clear` before they
+             *  are reused, so only enable this if the protocol overrides
+             *  `clear` to reset all of its members. By default, objects are
+             *  not recycled (see NET_POOL_CAPACITY).
+             *  @param size: maximum number of spare objects (0 = off)
+             */
+            inline void setPoolSize(std::size_t const size) {
+                this->pool.setCapacity(size);
+            }
+
+            /// Compress large outgoing objects
+            /**
+             * Objects whose packed data has at least `threshold` bytes are
+             *  deflated when they are pushed (see <net/compress.hpp>), if
+             *  this makes them smaller. The server decompresses them before
+             *  unpacking, so the protocol is not affected. Objects are only
+             *  compressed if the server announced to inflate them while
+             *  connecting. Compression needs
+             *  NET_USE_ZLIB to be defined. This must be called before the
+             *  client is connected.
+             *  @param threshold: minimum size to compress (0 = off)
+             *  @param level: zlib compression level (-1 = zlib's default)
+             *  @return false if the client is online or compression is not
+             *      available
+             */
+            inline bool setCompression(std::size_t const threshold,
+                                       int const level=-1) {
+                if (this->isOnline()) {
+                    return false;
+                }
+                return this->compression.configure(threshold, level);
+            }
+
+            /// Reconnect automatically after the link was lost
+            /**
+             * The client maintains a session at the server. If its link is
+             *  lost, it reconnects after a random delay, which doubles with
+             *  each attempt, and resumes the session: it keeps its ID and
+             *  groups and receives the objects that were queued for it in the
+             *  meantime (see `Server::setSessionTimeout`). Sent objects are
+             *  kept until the server acknowledged them, so objects that were
+             *  lost with the link are sent again. The application is notified
+             *  by `reconnected`. This must be called before the client is
+             *  connected.
+             *  @param min: delay of the first attempt (0 = off)
+             *  @param max: largest delay
+             *  @param attempts: maximum number of attempts (0 = unlimited)
+             *  @param replay: maximum number of unacknowledged objects
+             *  @return false if the client is online
+             */
+            bool setReconnect(std::chrono::milliseconds const min,
+                              std::chrono::milliseconds const max,
+                              std::size_t const attempts=10,
+                              std::size_t const replay=1024);
+
+            /// Returns the latency histogram of a pipeline stage
+            /**
+             * Latencies are only measured if NET_PROFILE is defined,
+             *  otherwise the histograms stay empty. All values are given in
+             *  nanoseconds.
+             *  @param stage: stage of the message pipeline
+             *  @return histogram of the stage
+             */
+            inline utils::Histogram const & getLatency(Stage const stage) const {
+                return this->profile[stage];
+            }
+
+            /// Remove all measured latencies
+            inline void resetLatency() {
+                this->profile.reset();
+            }
+
+            /// Returns a snapshot of the client's statistics
+            /**
+             * Write the snapshot to a stream to obtain a text dump.
+             *  @return statistics
+             */
+            ClientStats getStats() {
+                ClientStats stats;
+                stats.time = utils::now();
+                stats.incoming = this->in.size();
+                stats.outgoing = this->backlog;
+                this->traffic.collect(stats.link);
+                this->timer.collect(stats.commands);
+                return stats;
             }
 
     };
     
-    template <typename Protocol>
-    Client<Protocol>::Client()
-        : CallbackManager<CommandID, Protocol &>() {
+    template <typename Protocol, template <typename> class Queue>
+    Client<Protocol, Queue>::Client()
+        : CallbackManager<CommandID, Protocol &>()
+        , port(0)
+        , inflates(false)
+        , offset(0)
+        , blocked(false)
+        , backlog(0)
+        , id(0)
+        , token(0)
+        , resilient(false)
+        , attempts(0)
+        , answered(false)
+        , resumed(false)
+        , reconnecting(false)
+        , stopping(false)
+        , closed(false)
+#ifdef NET_USE_COROUTINES
+        , requests(std::uint64_t(1) << 32)
+#endif
+        {
         // Workaround for Tcp Socket Crash
         utils::SocketCrashWorkaround();
     }
 
-    template <typename Protocol>
-    Client<Protocol>::~Client() {
+    template <typename Protocol, template <typename> class Queue>
+    Client<Protocol, Queue>::~Client() {
         if (this->isOnline()) {
             this->disconnect();
         }
     }
     
-    template <typename Protocol>
-    bool Client<Protocol>::sendNext() {
-        // Pick next from outgoing queue
-        Protocol object;
-        if (!this->out.pop(object)) {
+    template <typename Protocol, template <typename> class Queue>
+    bool Client<Protocol, Queue>::flush() {
+        utils::FramePtr frame;
+        while (true) {
+            // Collect a batch of frames
+            while (this->pending.size() < utils::MAX_BATCH
+                   && this->out.pop(frame)) {
+                this->pending.push_back(std::move(frame));
+            }
+            if (this->pending.empty()) {
+                break;
+            }
+            // Send (the rest of) the batch to the server
+            auto end = this->pending.end();
+            if (this->pending.size() > utils::MAX_BATCH) {
+                // Frames that are sent again exceed the batch
+                end = this->pending.begin() + utils::MAX_BATCH;
+            }
+            std::size_t sent = 0;
+            auto status = utils::sendFrames(this->link, this->pending.begin(),
+                                            end, this->offset, sent);
+            // Drop all frames that were sent completely
+            std::size_t count = 0;
+            this->offset += sent;
+            while (!this->pending.empty()
+                   && this->offset >= this->pending.front()->size()) {
+                auto & front = this->pending.front();
+                this->offset -= front->size();
+                this->traffic.send(front->size());
+#ifdef NET_PROFILE
+                this->profile.since(Stage::Outgoing, front->created());
+#endif
+                if (this->resilient) {
+                    // Keep it until the server acknowledged it
+                    this->replay.push(front);
+                }
+                this->pending.pop_front();
+                count++;
+            }
+            this->backlog -= count;
+            if (status == sf::Socket::Done) {
+                continue;
+            }
+            if (status == sf::Socket::Partial
+                || status == sf::Socket::NotReady) {
+                // Link is busy: continue as soon as it is writable
+                if (!this->blocked) {
+                    this->blocked = true;
+#ifdef NET_USE_EPOLL
+                    this->poller.modify(utils::getHandle(this->link), 0, true);
+#endif
+                }
+                return false;
+            }
+            // Pipe broken
+            this->lost();
             return false;
         }
-        // Send to server
-        if (!object.send(this->link)) {
-            // Cannot send
-            if (!this->isOnline()) {
-                // Pipe broken
-                this->link.disconnect();
-            }
+        if (this->blocked) {
+            // Link is not observed for writability anymore
+            this->blocked = false;
+#ifdef NET_USE_EPOLL
+            this->poller.modify(utils::getHandle(this->link), 0, false);
+#endif
+        }
+        return true;
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    bool Client<Protocol, Queue>::receiveNext() {
+        // Receive as many bytes as available
+        auto status = this->reader.receive(this->link);
+        if (status == sf::Socket::NotReady) {
+            // Nothing happened
+            return false;
+        }
+        if (status != sf::Socket::Done) {
+            // Pipe broken
+            this->lost();
             return false;
         }
+#ifdef NET_PROFILE
+        auto received = utils::now();
+#endif
+        // Unpack all complete objects
+        char const * data;
+        std::size_t size;
+        std::uint32_t flags;
+        while (this->reader.next(data, size, flags)) {
+            this->traffic.receive(size + utils::Frame::HEADER);
+            if (flags & utils::Frame::CONTROL) {
+                this->receiveControl(data, size);
+                continue;
+            }
+            if ((flags & utils::Frame::COMPRESSED)
+                && !this->inflater.inflate(data, size)) {
+                std::cerr << "Cannot inflate object from the server"
+                          << std::endl << std::flush;
+                continue;
+            }
+            CallID call = 0;
+            if ((flags & utils::Frame::CALL)
+                && !utils::takeCall(data, size, call)) {
+                std::cerr << "Invalid call response from the server"
+                          << std::endl << std::flush;
+                continue;
+            }
+            auto object = this->pool.acquire();
+            if (!object->decode(data, size, this->packet)) {
+                std::cerr << "Cannot unpack object from the server"
+                          << std::endl << std::flush;
+                continue;
+            }
+            object->call = call;
+#ifdef NET_PROFILE
+            object->received = received;
+            object->queued = utils::now();
+            this->profile.record(Stage::Receive, object->queued - received);
+#endif
+            // Push to incomming queue
+            this->in.push(std::move(object));
+        }
         return true;
     }
 
-    template <typename Protocol>
-    bool Client<Protocol>::receiveNext() {
-        // Try to receive next
-        Protocol object;
-        if (!object.receive(this->link)) {
-            // Cannot receive
-            if (!this->isOnline()) {
-                // Pipe broken
+    template <typename Protocol, template <typename> class Queue>
+    void Client<Protocol, Queue>::receiveControl(char const * data,
+                                                 std::size_t size) {
+        utils::Control message;
+        if (!message.decode(data, size, this->packet)) {
+            std::cerr << "Invalid control message from the server"
+                      << std::endl << std::flush;
+            return;
+        }
+        if (message.type == utils::Control::Ack) {
+            this->replay.acknowledge(message.sequence);
+            return;
+        }
+        // Answer to the session request
+        this->resumed = (this->token != 0 && message.id == this->id
+                         && message.token == this->token);
+        if (this->resumed) {
+            // Send all objects again that the server did not receive
+            this->replay.acknowledge(message.sequence);
+            this->backlog += this->replay.replay(this->pending);
+        } else {
+            // Objects of a previous session are not sent again
+            this->replay.reset(message.sequence);
+            this->id = message.id;
+            this->token = message.token;
+        }
+        this->answered = true;
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    bool Client<Protocol, Queue>::open(sf::Time const timeout) {
+        // Connect
+        this->link.setBlocking(true);
+        auto status = this->link.connect(sf::IpAddress(this->host),
+                                         this->port, timeout);
+        if (status != sf::Socket::Done) {
+            this->link.disconnect();
+            return false;
+        }
+        // Receive ClientID
+        sf::Packet packet;
+        status = this->link.receive(packet);
+        if (status != sf::Socket::Done) {
+            // Got invalid ClientID or nothing
+            this->link.disconnect();
+            return false;
+        }
+        ClientID id = 0;
+        sf::Uint8 inflates = 0;
+        // Servers that do not announce compression do not inflate frames
+        packet >> id >> inflates;
+        this->inflates = (inflates != 0);
+        if (utils::Compression::isAvailable()) {
+            // Announce that compressed frames are accepted
+            auto announce = utils::Control(utils::Control::Compress).encode();
+            std::size_t sent = 0;
+            status = utils::sendFrames(this->link, &announce, &announce + 1,
+                                       0, sent);
+            if (status != sf::Socket::Done) {
                 this->link.disconnect();
+                return false;
             }
-            return false;
         }
-        // Push to incomming queue
-        this->in.push(object);
+        this->link.setBlocking(false);
+        this->reader.clear();
+        this->offset = 0;
+        this->blocked = false;
+        this->resumed = false;
+#ifdef NET_USE_EPOLL
+        this->poller.add(utils::getHandle(this->link), 0);
+#endif
+        if (!this->resilient) {
+            this->id = id;
+        } else {
+            // Request a new session or resume the previous one
+            auto request = utils::Control(utils::Control::Session, this->id,
+                this->token, this->replay.base()).encode();
+            auto deadline = std::chrono::steady_clock::now()
+                          + std::chrono::milliseconds(NET_CONNECT_TIMEOUT);
+            std::size_t offset = 0;
+            this->answered = false;
+            while (!this->answered) {
+                if (offset < request->size()) {
+                    std::size_t sent = 0;
+                    status = utils::sendFrames(this->link, &request,
+                                               &request + 1, offset, sent);
+                    offset += sent;
+                    if (status != sf::Socket::Done
+                        && status != sf::Socket::Partial
+                        && status != sf::Socket::NotReady) {
+                        this->link.disconnect();
+                    }
+                }
+                // Objects received meanwhile are handled as usual
+                if (!this->receiveNext()) {
+                    if (!this->isConnected() || this->stopping
+                        || std::chrono::steady_clock::now() > deadline) {
+                        this->link.disconnect();
+                        return false;
+                    }
+                    utils::delay(1);
+                }
+            }
+        }
+        if (this->resumed) {
+            std::cerr << "Session #" << this->id << " resumed by the server at "
+                      << this->host << ":" << this->port << std::endl
+                      << std::flush;
+        } else {
+            std::cerr << "Authed as #" << this->id << " by the server at "
+                      << this->host << ":" << this->port << std::endl
+                      << std::flush;
+        }
         return true;
     }
 
-    template <typename Protocol>
-    void Client<Protocol>::network_loop() {
-        do {
-            // Send all objects
-            while (this->sendNext()) {}
-            // Receive all objects
-            while (this->receiveNext()) {}
-            // delay a bit
-            utils::delay(25);
-        } while (this->isOnline());
-        std::cerr << "Connection to the server was lost" << std::endl
+    template <typename Protocol, template <typename> class Queue>
+    void Client<Protocol, Queue>::lost() {
+        if (this->resilient && !this->stopping) {
+            // Stay online while reconnecting
+            this->reconnecting = true;
+        }
+        this->link.disconnect();
+        // Partially sent frame is sent again after reconnecting
+        this->offset = 0;
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    bool Client<Protocol, Queue>::reconnect() {
+        if (!this->resilient || this->stopping) {
+            return false;
+        }
+        this->reconnecting = true;
+        std::cerr << "Connection to the server was lost, reconnecting"
+                  << std::endl << std::flush;
+        this->backoff.reset();
+        for (std::size_t attempt = 0;
+             this->attempts == 0 || attempt < this->attempts; attempt++) {
+            // Wait a random, increasing time
+            auto until = std::chrono::steady_clock::now()
+                       + this->backoff.next();
+            while (std::chrono::steady_clock::now() < until) {
+                if (this->stopping) {
+                    this->reconnecting = false;
+                    return false;
+                }
+                utils::delay(10);
+            }
+            if (this->open(sf::milliseconds(NET_CONNECT_TIMEOUT))) {
+                this->reconnecting = false;
+                this->reconnected(this->resumed);
+                return true;
+            }
+        }
+        this->reconnecting = false;
+        std::cerr << "Cannot reconnect to the server" << std::endl
                   << std::flush;
+        return false;
     }
 
-    template <typename Protocol>
-    void Client<Protocol>::handle_loop()  {
+    template <typename Protocol, template <typename> class Queue>
+    void Client<Protocol, Queue>::network_loop() {
         do {
-            // Pick next from incomming queue
-            Protocol object;            
-            if (!this->in.pop(object)) {
-                // Nothing to do
+#ifdef NET_USE_EPOLL
+            std::vector<utils::Poller::Event> events;
+            do {
+                // Send all objects
+                if (!this->blocked) {
+                    this->flush();
+                }
+                // Wait for readiness of the link or outgoing queue
+                this->poller.wait(events);
+                for (auto e = events.begin(); e != events.end(); e++) {
+                    if (e->token == utils::Poller::WAKEUP) {
+                        // Outgoing queue is handled above
+                        continue;
+                    }
+                    if (e->writable && !e->closed) {
+                        // Continue sending
+                        this->flush();
+                    }
+                    if (e->readable || e->closed) {
+                        // Receive all objects (until the link broke)
+                        while (this->receiveNext()) {}
+                    }
+                }
+            } while (this->isConnected() && !this->stopping);
+#else
+            do {
+                // Send all objects
+                this->flush();
+                // Receive all objects
+                while (this->receiveNext()) {}
+                // delay a bit
                 utils::delay(25);
-                continue;
+            } while (this->isConnected() && !this->stopping);
+#endif
+        } while (this->reconnect());
+        if (!this->stopping) {
+            std::cerr << "Connection to the server was lost" << std::endl
+                      << std::flush;
+        }
+        // let the handler finish the remaining objects
+        this->closed = true;
+        this->in.close();
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    void Client<Protocol, Queue>::handle_loop()  {
+        std::vector<utils::Pooled<Protocol>> batch;
+        while (true) {
+            // Wait for objects or the next call (or coroutine) to time out
+            auto deadline = this->calls.next();
+#ifdef NET_USE_COROUTINES
+            deadline = utils::earliest(deadline, this->coroutines.next());
+#endif
+            if (this->in.waitPop(batch, 64, utils::until(deadline)) == 0
+                && this->closed && this->in.size() == 0) {
+                // Incomming queue was closed
+                break;
+            }
+            for (auto object = batch.begin(); object != batch.end(); object++) {
+                if ((*object)->call != 0) {
+                    // Complete the call (unless it timed out)
+                    this->calls.complete((*object)->call, **object);
+                    continue;
+                }
+#ifdef NET_USE_COROUTINES
+                if (this->coroutines.deliver((*object)->command, **object)) {
+                    // Awaited by a coroutine
+                    continue;
+                }
+#endif
+                auto command = (*object)->command;
+                auto start = utils::now();
+#ifdef NET_PROFILE
+                this->profile.record(Stage::Incoming,
+                                     start - (*object)->queued);
+#endif
+                // Trigger callback method
+                this->trigger(command, **object);
+                auto duration = utils::now() - start;
+#ifdef NET_PROFILE
+                this->profile.record(Stage::Handler, duration);
+#endif
+                this->timer.record(command, duration);
+            }
+            // Recycle the objects
+            batch.clear();
+            auto now = utils::now();
+            this->calls.expire(now);
+#ifdef NET_USE_COROUTINES
+            this->coroutines.run(now);
+#endif
+        }
+        // Calls cannot be answered anymore
+        this->calls.cancel();
+#ifdef NET_USE_COROUTINES
+        this->coroutines.cancel();
+#endif
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    bool Client<Protocol, Queue>::call(Protocol & request,
+                                       Completion completion,
+                                       std::chrono::milliseconds const timeout) {
+        if (!completion) {
+            std::cerr << "Call of #" << request.command
+                      << " has no completion" << std::endl << std::flush;
+            return false;
+        }
+        if (!this->isOnline()) {
+            return false;
+        }
+        // Register the call before its response can arrive
+        bool earliest = false;
+        auto id = this->calls.add(std::move(completion), timeout, earliest);
+        auto frame = utils::encodeCall(request, id);
+        if (this->inflates) {
+            frame = this->compression.apply(frame);
+        }
+        if (frame == NULL) {
+            this->calls.remove(id);
+            std::cerr << "Cannot pack #" << request.command << std::endl
+                      << std::flush;
+            return false;
+        }
+        if (earliest) {
+            // Handler waits for a later deadline
+            this->in.interrupt();
+        }
+        this->backlog++;
+        this->out.push(std::move(frame));
+        this->wakeup();
+        return true;
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    std::future<Protocol> Client<Protocol, Queue>::call(Protocol & request,
+        std::chrono::milliseconds const timeout) {
+        auto promise = std::make_shared<std::promise<Protocol>>();
+        auto future = promise->get_future();
+        auto sent = this->call(request, [promise](Protocol * response) {
+            if (response != NULL) {
+                promise->set_value(*response);
+            } else {
+                promise->set_exception(std::make_exception_ptr(
+                    std::system_error(std::make_error_code(
+                        std::errc::timed_out))));
             }
-            // Trigger callback method
-            this->trigger(object.command, object);
-        } while (this->isOnline());
+        }, timeout);
+        if (!sent) {
+            promise->set_exception(std::make_exception_ptr(std::system_error(
+                std::make_error_code(std::errc::not_connected))));
+        }
+        return future;
     }
 
-    template <typename Protocol>
-    bool Client<Protocol>::connect(std::string const & ip, std::uint16_t const port) {
+#ifdef NET_USE_COROUTINES
+    template <typename Protocol, template <typename> class Queue>
+    utils::Awaiter<Protocol> Client<Protocol, Queue>::await(
+        std::chrono::milliseconds const timeout) {
+        // Do not suspend if the handler thread is not running
+        utils::Awaiter<Protocol> awaiter((this->isOnline() && !this->closed)
+                                         ? &this->coroutines : NULL);
+        awaiter.within(timeout);
+        awaiter.suspended = [this](bool const earliest) {
+            if (earliest) {
+                // Handler waits for a later deadline
+                this->in.interrupt();
+            }
+        };
+        return awaiter;
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    utils::Awaiter<Protocol> Client<Protocol, Queue>::receive(
+        CommandID const command, std::chrono::milliseconds const timeout) {
+        auto awaiter = this->await(timeout);
+        awaiter.on(command);
+        return awaiter;
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    utils::Awaiter<Protocol> Client<Protocol, Queue>::request(
+        Protocol & request, std::chrono::milliseconds const timeout) {
+        // Timeout is applied by the call
+        auto awaiter = this->await(utils::FOREVER);
+        auto key = this->requests++;
+        awaiter.on(key);
+        auto object = &request;
+        awaiter.suspended = [this, key, object, timeout](bool) {
+            // Send the request when its response can be awaited
+            auto sent = this->call(*object, [this, key](Protocol * response) {
+                if (response != NULL) {
+                    this->coroutines.deliver(key, *response);
+                } else {
+                    // Resumed after the expired calls
+                    this->coroutines.notify(key);
+                }
+            }, timeout);
+            if (!sent && this->coroutines.notify(key)) {
+                this->in.interrupt();
+            }
+        };
+        return awaiter;
+    }
+#endif
+
+    template <typename Protocol, template <typename> class Queue>
+    bool Client<Protocol, Queue>::connect(std::string const & ip, std::uint16_t const port) {
         if (this->isOnline()) {
             // Already connected
             return true;
         }
-        // Connect
-        auto status = this->link.connect(sf::IpAddress(ip), port);
-        if (status != sf::Socket::Done) {
+        this->host = ip;
+        this->port = port;
+        // Start a new session
+        this->token = 0;
+        this->replay.reset();
+        this->stopping = false;
+        this->closed = false;
+        this->in.reopen();
+        if (!this->open(sf::Time::Zero)) {
+            this->reconnecting = false;
             return false;
         }
-        // Receive ClientID
-        sf::Packet packet;
-        status = this->link.receive(packet);
-        if (status != sf::Socket::Done) {
-            // Got invalid ClientID or nothing
-            this->link.disconnect();
+        // Start Threads
+        this->networker = std::thread(&Client<Protocol, Queue>::network_loop, this);
+        this->handler   = std::thread(&Client<Protocol, Queue>::handle_loop, this);
+        return true;
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    bool Client<Protocol, Queue>::setReconnect(
+        std::chrono::milliseconds const min,
+        std::chrono::milliseconds const max, std::size_t const attempts,
+        std::size_t const replay) {
+        if (this->isOnline()) {
             return false;
         }
-        packet >> this->id;
-        std::cerr << "Authed as #" << this->id << " by the server at " << ip
-                  << ":" << port << std::endl << std::flush;
-        this->link.setBlocking(false);
-        // Start Threads
-        this->networker = std::thread(&Client<Protocol>::network_loop, this);
-        this->handler   = std::thread(&Client<Protocol>::handle_loop, this);
+        this->resilient = (min.count() > 0);
+        this->backoff = utils::Backoff(min, max);
+        this->attempts = attempts;
+        this->replay.setCapacity(replay);
         return true;
     }
 
-    template <typename Protocol>
-    void Client<Protocol>::shutdown() {
-        // wait until outgoing queue is empty
+    template <typename Protocol, template <typename> class Queue>
+    void Client<Protocol, Queue>::shutdown() {
+        // wait until all pushed objects were sent
         // @note: data that is pushed while this queue is waiting might be lost
-        while (this->isOnline() && !this->out.isEmpty()) {
-            utils::delay(15);
+        while (this->isOnline() && this->backlog > 0) {
+            if (this->out.waitEmpty(std::chrono::milliseconds(100))) {
+                // Wait for the frames that are being sent
+                utils::delay(1);
+            }
         }
         this->disconnect();
     }
 
-    template <typename Protocol>
-    void Client<Protocol>::disconnect() {
-        // close connection
-        this->link.disconnect();
-        // shutdown threads (try-catched, because they might have been stopped, yet)
+    template <typename Protocol, template <typename> class Queue>
+    void Client<Protocol, Queue>::disconnect() {
+        // stop the network thread (it might be reconnecting)
+        this->stopping = true;
+        this->wakeup();
         try {
             this->networker.join();
         } catch (std::system_error const & se) {}
+        if (this->resilient && this->token != 0 && this->isConnected()) {
+            // End the session, so the server does not keep it
+            auto frame = utils::Control(utils::Control::Close, this->id)
+                .encode();
+            std::size_t sent = 0;
+            utils::sendFrames(this->link, &frame, &frame + 1, 0, sent);
+        }
+        // close connection
+        this->link.disconnect();
+        this->reconnecting = false;
+        this->closed = true;
+        this->in.close();
+        // shutdown threads (try-catched, because they might have been stopped, yet)
         try {
             this->handler.join();
         } catch (std::system_error const & se) {}
         // clear queues
         this->in.clear();
         this->out.clear();
+        this->pending.clear();
+        this->backlog = 0;
+        // Complete calls if the handler was not running
+        this->calls.cancel();
+#ifdef NET_USE_COROUTINES
+        this->coroutines.cancel();
+#endif
     }
 
 }
 
 #endif
-
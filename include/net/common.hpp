@@ -30,10 +30,13 @@ SOFTWARE.
 #define NET_COMMON_INCLUDE_GUARD
 
 #include <iostream>
+#include <atomic>
 #include <chrono>
 #include <queue>
 #include <mutex>
+#include <condition_variable>
 #include <thread>
+#include <vector>
 #include <map>
 
 #include <signal.h>
@@ -48,6 +51,9 @@ namespace net {
     /// Type for client IDs (unsigned 16-bit integer with fixed size)
     typedef std::uint32_t ClientID;
 
+    /// Type for IDs of remote calls (0 means no call)
+    typedef std::uint32_t CallID;
+
     namespace utils {
     
         /// Workaround see http://en.sfml-dev.org/forums/index.php?topic=9092.msg61423#msg61423
@@ -67,21 +73,101 @@ namespace net {
             std::this_thread::sleep_for(std::chrono::milliseconds(ms));
         }
 
+        /// Timeout value to wait without limit
+        std::chrono::milliseconds const FOREVER =
+            std::chrono::milliseconds::max();
+
+        /// Wakeup signal for lock-free structures
+        /**
+         * Threads can wait on this signal until a given predicate becomes
+         *  true. Notifying is lock-free as long as no thread is waiting, so
+         *  producers (e.g. of the lock-free queues) only pay for a wakeup if a
+         *  consumer is actually sleeping.
+         */
+        class Signal {
+            protected:
+                /// mutex for the condition variable
+                std::mutex mutex;
+                /// condition variable to sleep on
+                std::condition_variable cond;
+                /// number of waiting threads
+                std::atomic<std::size_t> waiters;
+
+            public:
+                /// Constructor
+                Signal()
+                    : waiters(0) {
+                }
+
+                /// Wait until the predicate is true
+                /**
+                 *  @param ready: predicate to wait for
+                 *  @param timeout: maximum time to wait
+                 *  @return result of the predicate
+                 */
+                template <typename Predicate>
+                bool wait(Predicate ready,
+                          std::chrono::milliseconds const timeout=FOREVER) {
+                    if (ready()) {
+                        return true;
+                    }
+                    std::unique_lock<std::mutex> lock(this->mutex);
+                    this->waiters.fetch_add(1);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    bool result = true;
+                    if (timeout == FOREVER) {
+                        this->cond.wait(lock, ready);
+                    } else {
+                        result = this->cond.wait_for(lock, timeout, ready);
+                    }
+                    this->waiters.fetch_sub(1);
+                    return result;
+                }
+
+                /// Wake up all waiting threads
+                /**
+                 * The caller must have made the predicate true before.
+                 */
+                inline void notify() {
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    if (this->waiters.load(std::memory_order_relaxed) > 0) {
+                        // serialize with a thread that is about to sleep
+                        this->mutex.lock();
+                        this->mutex.unlock();
+                        this->cond.notify_all();
+                    }
+                }
+        };
+
         /// Thread-Safe, Template-Based Queue
         /**
          * This class provides accessing a fifo queue in a thread-safe way. It can
          *  me implemented by using a specific typeparameter as base of the data.
+         *  Consumers can wait for data using `waitPop`. After `close` was
+         *  called, waiting consumers are woken up and `waitPop` fails as soon
+         *  as the queue is empty. `interrupt` wakes up a waiting consumer
+         *  without pushing anything.
          */
         template <typename Data>
         class SyncQueue {
             protected:
                 /// mutex for thread-safety of push/pop
                 std::mutex mutex;
+                /// signaled if data was pushed or the queue was closed
+                std::condition_variable filled;
+                /// signaled if the queue was emptied
+                std::condition_variable drained;
                 /// actual queue with pointers
                 std::queue<Data> data;
+                /// whether the queue was closed
+                bool closed;
+                /// whether the next wait returns without data
+                bool interrupted;
             public:
                 /// Constructor
-                SyncQueue() {
+                SyncQueue()
+                    : closed(false)
+                    , interrupted(false) {
                 }
                 /// Destructor
                 virtual ~SyncQueue() {
@@ -93,6 +179,7 @@ namespace net {
                         this->data.pop();
                     }
                     this->mutex.unlock();
+                    this->drained.notify_all();
                 }
                 /// Push data to the queue
                 /**
@@ -103,6 +190,24 @@ namespace net {
                     this->mutex.lock();
                     this->data.push(data);
                     this->mutex.unlock();
+                    this->filled.notify_one();
+                }
+                inline void push(Data && data) {
+                    this->mutex.lock();
+                    this->data.push(std::move(data));
+                    this->mutex.unlock();
+                    this->filled.notify_one();
+                }
+                /// Construct an object inside the queue
+                /**
+                 *  @param args: arguments for the object's constructor
+                 */
+                template <typename... Args>
+                inline void emplace(Args &&... args) {
+                    this->mutex.lock();
+                    this->data.emplace(std::forward<Args>(args)...);
+                    this->mutex.unlock();
+                    this->filled.notify_one();
                 }
                 /// Pop object from queue.
                 /**
@@ -116,12 +221,106 @@ namespace net {
                     this->mutex.lock();
                     bool success = !this->data.empty();
                     if (success) {
-                        result = this->data.front();
+                        result = std::move(this->data.front());
                         this->data.pop();
                     }
+                    bool empty = this->data.empty();
                     this->mutex.unlock();
+                    if (empty) {
+                        this->drained.notify_all();
+                    }
                     return success;
                 }
+                /// Wait for an object and pop it
+                /**
+                 * This blocks until an object was pushed, the queue was
+                 *  closed or the timeout expired.
+                 *  @param result: object to store the data in
+                 *  @param timeout: maximum time to wait
+                 *  @return bool describing data was obtained or not
+                 */
+                bool waitPop(Data & result,
+                             std::chrono::milliseconds const timeout=FOREVER) {
+                    std::unique_lock<std::mutex> lock(this->mutex);
+                    if (!this->wait(lock, timeout)) {
+                        return false;
+                    }
+                    result = std::move(this->data.front());
+                    this->data.pop();
+                    if (this->data.empty()) {
+                        this->drained.notify_all();
+                    }
+                    return true;
+                }
+                /// Wait for objects and pop a batch of them
+                /**
+                 * This blocks like `waitPop`, but moves up to `limit` objects
+                 *  to the given vector using a single lock.
+                 *  @param result: vector to append the objects to
+                 *  @param limit: maximum number of objects
+                 *  @param timeout: maximum time to wait
+                 *  @return number of objects that were popped
+                 */
+                std::size_t waitPop(std::vector<Data> & result,
+                                    std::size_t const limit,
+                            std::chrono::milliseconds const timeout=FOREVER) {
+                    std::unique_lock<std::mutex> lock(this->mutex);
+                    if (!this->wait(lock, timeout)) {
+                        return 0;
+                    }
+                    std::size_t n = 0;
+                    while (n < limit && !this->data.empty()) {
+                        result.push_back(std::move(this->data.front()));
+                        this->data.pop();
+                        n++;
+                    }
+                    if (this->data.empty()) {
+                        this->drained.notify_all();
+                    }
+                    return n;
+                }
+                /// Wait until the queue is empty
+                /**
+                 *  @param timeout: maximum time to wait
+                 *  @return true if the queue is empty
+                 */
+                bool waitEmpty(std::chrono::milliseconds const timeout=FOREVER) {
+                    std::unique_lock<std::mutex> lock(this->mutex);
+                    auto empty = [this]() { return this->data.empty(); };
+                    if (timeout == FOREVER) {
+                        this->drained.wait(lock, empty);
+                        return true;
+                    }
+                    return this->drained.wait_for(lock, timeout, empty);
+                }
+                /// Close the queue
+                /**
+                 * This wakes up all waiting consumers. Remaining objects can
+                 *  still be popped.
+                 */
+                inline void close() {
+                    this->mutex.lock();
+                    this->closed = true;
+                    this->mutex.unlock();
+                    this->filled.notify_all();
+                }
+                /// Reopen a closed queue
+                inline void reopen() {
+                    this->mutex.lock();
+                    this->closed = false;
+                    this->mutex.unlock();
+                }
+                /// Wake up a waiting consumer without pushing data
+                /**
+                 * The consumer's current or next wait returns without data.
+                 *  Any thread can interrupt the queue.
+                 */
+                inline void interrupt() {
+                    this->mutex.lock();
+                    this->interrupted = true;
+                    this->mutex.unlock();
+                    this->filled.notify_all();
+                }
                 /// Non-threadsafe emptiness check
                 /**
                  * This function checks for an empty internal queue. Consider that
@@ -132,6 +331,31 @@ namespace net {
                 inline bool isEmpty() {
                     return this->data.empty();
                 }
+                /// Returns the number of objects inside the queue
+                inline std::size_t size() {
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    return this->data.size();
+                }
+
+            protected:
+                /// Wait for data, closing or an interrupt (lock must be held)
+                /**
+                 *  @return true if data is available
+                 */
+                bool wait(std::unique_lock<std::mutex> & lock,
+                          std::chrono::milliseconds const timeout) {
+                    auto ready = [this]() {
+                        return !this->data.empty() || this->closed
+                            || this->interrupted;
+                    };
+                    if (timeout == FOREVER) {
+                        this->filled.wait(lock, ready);
+                    } else {
+                        this->filled.wait_for(lock, timeout, ready);
+                    }
+                    this->interrupted = false;
+                    return !this->data.empty();
+                }
         };
 
     }
@@ -144,34 +368,91 @@ namespace net {
      *  the client-server structure. So your protocol should capture all your
      *  application's needs.
      *  Keep in memory to use instances of your protocol for each data package.
+     *  Implement `pack` and `unpack` to serialize your data into packets.
+     *  The server encodes each outgoing object once using `pack`, so the
+     *  result must not depend on the target `client`.
      */
     class BaseProtocol {
 
         public:
             /// Default constructor
-            BaseProtocol() {}
+            BaseProtocol()
+                : call(0) {
+            }
             /// Default destructor
             virtual ~BaseProtocol() {}
 
-            /// Virtual method for sending data using a socket
+            /// Virtual method for serializing data into a packet
+            /**
+             *  @param packet: packet to write the data to
+             *  @return true in case of success
+             */
+            virtual bool pack(sf::Packet & packet) = 0;
+            /// Virtual method for deserializing data from a packet
             /**
-             * This must'n work blocking!
-             *  @param socket: socket to use for sending
-             *  @return true in case of success 
+             *  @param packet: packet to read the data from
+             *  @return true in case of success
              */
-            virtual bool send(sf::TcpSocket & socket) { return true; }
-            /// Virtual method for receiving data using a socket
+            virtual bool unpack(sf::Packet & packet) = 0;
+            /// Virtual method for resetting a recycled object
             /**
-             * This must'n work blocking!
-             *  @param socket: socket to use for receiving
+             * Received objects can be recycled (see `setPoolSize`). Before
+             *  such an object is reused, this is called to drop the values
+             *  of its last use. Override this to reset all members of your
+             *  protocol, e.g. by clearing strings and vectors, which keeps
+             *  their capacity. The default implementation only resets the
+             *  members of this class.
+             */
+            virtual void clear() {
+                this->command = 0;
+                this->client = 0;
+                this->call = 0;
+            }
+            /// Virtual method for deserializing data from received bytes
+            /**
+             * The bytes are only valid during this call. The default
+             *  implementation copies them into the given packet, which is
+             *  reused for all objects of a connection, and calls `unpack`.
+             *  Override this to deserialize directly from the bytes.
+             *  @param data: received bytes of a single packet
+             *  @param size: number of bytes
+             *  @param packet: reusable packet
              *  @return true in case of success
              */
-            virtual bool receive(sf::TcpSocket & socket) { return true; }
+            virtual bool decode(char const * data, std::size_t size,
+                                sf::Packet & packet) {
+                packet.clear();
+                packet.append(data, size);
+                return this->unpack(packet);
+            }
+
+            /// Sending by the protocol is not supported anymore
+            /**
+             * Objects are encoded into frames by `pack` and written by the
+             *  library. This is deleted, so protocols that still override it
+             *  fail to compile; implement `pack` instead.
+             */
+            virtual bool send(sf::TcpSocket & socket) = delete;
+            /// Receiving by the protocol is not supported anymore
+            /**
+             * Received frames are passed to `decode` (or `unpack`). This is
+             *  deleted, so protocols that still override it fail to compile;
+             *  implement `unpack` instead.
+             */
+            virtual bool receive(sf::TcpSocket & socket) = delete;
             
             /// Command ID
             CommandID command;
             /// Client ID (source or target, depends on context)
             ClientID client;
+            /// ID of the remote call this object belongs to (see <net/rpc.hpp>)
+            CallID call;
+#ifdef NET_PROFILE
+            /// Time the object's bytes were read or the object was pushed
+            std::uint64_t received;
+            /// Time the object was put into the incomming queue
+            std::uint64_t queued;
+#endif
 
     };
 
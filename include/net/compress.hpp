@@ -0,0 +1,273 @@
+/*
+Copyright (c) 2013 Christian Glöckner <cgloeckner@freenet.de>
+
+This file is part of the networking module:
+    https://github.com/cgloeckner/networking
+
+It offers a tcp-based server-client framework for games and other software.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#ifndef NET_COMPRESS_INCLUDE_GUARD
+#define NET_COMPRESS_INCLUDE_GUARD
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+#include <SFML/Network.hpp>
+
+#include <net/frame.hpp>
+
+// Frames are only compressed if NET_USE_ZLIB is defined (link with -lz).
+// Otherwise compression cannot be enabled and compressed frames are refused.
+#ifdef NET_USE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace net {
+
+    namespace utils {
+
+        /// Compression of outgoing frames
+        /**
+         * Frames whose data exceeds a threshold are deflated if this makes
+         *  them smaller. A compressed frame is flagged by
+         *  `Frame::COMPRESSED`; its data is the 32-bit size of the original
+         *  data followed by a zlib stream. Each frame is compressed on its
+         *  own, so it is compressed once even if it is sent to many clients,
+         *  and it can be sent again (e.g. after a session was resumed)
+         *  without depending on other frames. Each thread reuses its own
+         *  deflate stream.
+         */
+        class Compression {
+            protected:
+                /// minimum size of data to compress (0 = off)
+                std::size_t threshold;
+                /// zlib compression level
+                int level;
+
+#ifdef NET_USE_ZLIB
+                /// Deflate stream of a thread
+                struct Deflater {
+                    z_stream stream;
+                    int level;
+                    bool ready;
+                    std::vector<char> buffer;
+
+                    Deflater()
+                        : level(0)
+                        , ready(false) {
+                    }
+
+                    ~Deflater() {
+                        if (this->ready) {
+                            deflateEnd(&this->stream);
+                        }
+                    }
+
+                    /// Prepare the stream for the next frame
+                    bool reset(int const level) {
+                        if (this->ready && this->level == level) {
+                            return (deflateReset(&this->stream) == Z_OK);
+                        }
+                        if (this->ready) {
+                            deflateEnd(&this->stream);
+                        }
+                        std::memset(&this->stream, 0, sizeof(this->stream));
+                        this->ready = (deflateInit(&this->stream, level)
+                                       == Z_OK);
+                        this->level = level;
+                        return this->ready;
+                    }
+                };
+#endif
+
+            public:
+                /// Constructor
+                Compression()
+                    : threshold(0)
+                    , level(-1) {
+                }
+
+                /// Returns whether frames can be compressed
+                static inline bool isAvailable() {
+#ifdef NET_USE_ZLIB
+                    return true;
+#else
+                    return false;
+#endif
+                }
+
+                /// Set the threshold and level
+                /**
+                 *  @param threshold: minimum size of data to compress (0 =
+                 *      off)
+                 *  @param level: zlib compression level (-1 = zlib's default)
+                 *  @return false if compression is not available
+                 */
+                bool configure(std::size_t const threshold, int const level) {
+                    if (threshold > 0 && !isAvailable()) {
+                        return false;
+                    }
+                    this->threshold = threshold;
+                    this->level = level;
+                    return true;
+                }
+
+                /// Compress a frame if it is large enough
+                /**
+                 *  @param frame: sealed frame (or an empty pointer)
+                 *  @return compressed frame, or the given frame if it is too
+                 *      small or does not shrink
+                 */
+                FramePtr apply(FramePtr const & frame) const {
+#ifdef NET_USE_ZLIB
+                    if (this->threshold == 0 || frame == NULL) {
+                        return frame;
+                    }
+                    auto size = frame->size() - Frame::HEADER;
+                    if (size < this->threshold || size <= 4) {
+                        return frame;
+                    }
+                    static thread_local Deflater deflater;
+                    if (!deflater.reset(this->level)) {
+                        return frame;
+                    }
+                    // Only keep the result if it is smaller than the data
+                    auto & buffer = deflater.buffer;
+                    buffer.resize(size);
+                    auto & stream = deflater.stream;
+                    stream.next_in = reinterpret_cast<Bytef *>(
+                        const_cast<char *>(frame->data()));
+                    stream.avail_in = uInt(size);
+                    stream.next_out = reinterpret_cast<Bytef *>(buffer.data());
+                    stream.avail_out = uInt(size - 4);
+                    if (deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+                        return frame;
+                    }
+                    auto compressed = std::make_shared<Frame>();
+                    auto & packet = compressed->body();
+                    packet << sf::Uint32(size);
+                    packet.append(buffer.data(), stream.total_out);
+                    compressed->seal(frame->flags() | Frame::COMPRESSED);
+                    return compressed;
+#else
+                    return frame;
+#endif
+                }
+        };
+
+        /// Decompression of a connection's frames
+        /**
+         * The inflate stream and the buffer are reused for all frames of the
+         *  connection.
+         */
+        class Inflater {
+            protected:
+                /// decompressed data of the last frame
+                std::vector<char> buffer;
+#ifdef NET_USE_ZLIB
+                /// inflate stream
+                z_stream stream;
+                /// whether the stream was initialized
+                bool ready;
+#endif
+
+            public:
+                /// Constructor
+                Inflater()
+#ifdef NET_USE_ZLIB
+                    : ready(false)
+#endif
+                {
+                }
+
+                Inflater(Inflater const &) = delete;
+                Inflater & operator=(Inflater const &) = delete;
+
+                /// Destructor
+                ~Inflater() {
+#ifdef NET_USE_ZLIB
+                    if (this->ready) {
+                        inflateEnd(&this->stream);
+                    }
+#endif
+                }
+
+                /// Decompress the data of a compressed frame
+                /**
+                 * The decompressed data is valid until the next call.
+                 *  @param data: frame's data, set to the decompressed data
+                 *  @param size: number of bytes, set to the decompressed size
+                 *  @return false if the data is invalid or exceeds
+                 *      NET_MAX_FRAME
+                 */
+                bool inflate(char const * & data, std::size_t & size) {
+#ifdef NET_USE_ZLIB
+                    if (size < 4) {
+                        return false;
+                    }
+                    auto bytes = reinterpret_cast<unsigned char const *>(data);
+                    auto original = (std::size_t(bytes[0]) << 24)
+                                  | (std::size_t(bytes[1]) << 16)
+                                  | (std::size_t(bytes[2]) << 8)
+                                  | std::size_t(bytes[3]);
+                    if (original > NET_MAX_FRAME) {
+                        return false;
+                    }
+                    if (this->ready) {
+                        this->ready = (inflateReset(&this->stream) == Z_OK);
+                    } else {
+                        std::memset(&this->stream, 0, sizeof(this->stream));
+                        this->ready = (inflateInit(&this->stream) == Z_OK);
+                    }
+                    if (!this->ready) {
+                        return false;
+                    }
+                    this->buffer.resize(original);
+                    this->stream.next_in = reinterpret_cast<Bytef *>(
+                        const_cast<char *>(data + 4));
+                    this->stream.avail_in = uInt(size - 4);
+                    this->stream.next_out = reinterpret_cast<Bytef *>(
+                        this->buffer.data());
+                    this->stream.avail_out = uInt(original);
+                    if (::inflate(&this->stream, Z_FINISH) != Z_STREAM_END
+                        || this->stream.total_out != original) {
+                        return false;
+                    }
+                    data = this->buffer.data();
+                    size = original;
+                    return true;
+#else
+                    (void)data;
+                    (void)size;
+                    return false;
+#endif
+                }
+        };
+
+    }
+
+}
+
+#endif // NET_COMPRESS_INCLUDE_GUARD
@@ -0,0 +1,416 @@
+/*
+Copyright (c) 2013 Christian Glöckner <cgloeckner@freenet.de>
+
+This file is part of the networking module:
+    https://github.com/cgloeckner/networking
+
+It offers a tcp-based server-client framework for games and other software.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#ifndef NET_COROUTINE_INCLUDE_GUARD
+#define NET_COROUTINE_INCLUDE_GUARD
+
+// Coroutine support is enabled if the compiler implements C++20 coroutines,
+// unless NET_NO_COROUTINES is defined.
+#if !defined(NET_NO_COROUTINES) && defined(__cpp_impl_coroutine) \
+    && defined(__has_include)
+#if __has_include(<coroutine>)
+#define NET_USE_COROUTINES
+#endif
+#endif
+
+#ifdef NET_USE_COROUTINES
+
+#include <set>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <iostream>
+#include <optional>
+#include <exception>
+#include <coroutine>
+#include <functional>
+#include <unordered_map>
+
+#include <net/common.hpp>
+#include <net/profile.hpp>
+
+namespace net {
+
+    /// Coroutine that runs on its own
+    /**
+     * A function returning `Task` can use `co_await` on the awaitables of
+     *  server and client (e.g. `receive` or `sleep`). The coroutine starts
+     *  immediately and is destroyed after it finished; nobody waits for it.
+     *  A suspended coroutine is resumed by the handler thread that
+     *  completes its awaitable, so it never blocks a thread while waiting.
+     *  Exceptions leaving the coroutine are reported and dropped.
+     */
+    class Task {
+        public:
+            struct promise_type {
+                inline Task get_return_object() noexcept {
+                    return Task();
+                }
+                inline std::suspend_never initial_suspend() noexcept {
+                    return {};
+                }
+                inline std::suspend_never final_suspend() noexcept {
+                    return {};
+                }
+                inline void return_void() noexcept {}
+                void unhandled_exception() noexcept {
+                    try {
+                        std::rethrow_exception(std::current_exception());
+                    } catch (std::exception const & e) {
+                        std::cerr << "Coroutine failed: " << e.what()
+                                  << std::endl << std::flush;
+                    } catch (...) {
+                        std::cerr << "Coroutine failed" << std::endl
+                                  << std::flush;
+                    }
+                }
+            };
+    };
+
+    namespace utils {
+
+        /// Suspended coroutines waiting for objects, events or a time
+        /**
+         * Each waiter either waits for a key, a deadline or both. It is
+         *  resumed exactly once: by `deliver` with an object for its key, or
+         *  with an empty result by `notify`, `run` (after its deadline or a
+         *  notification) or `cancel`. Waiters of the same key are served in
+         *  order. Coroutines are resumed without holding the lock, so they
+         *  may wait again immediately.
+         */
+        template <typename T>
+        class Scheduler {
+            public:
+                /// Suspended coroutine
+                struct Waiter {
+                    /// coroutine to resume
+                    std::coroutine_handle<> handle;
+                    /// delivered object (empty on timeout or notification)
+                    std::optional<T> result;
+                    /// key to wait for
+                    std::uint64_t key = 0;
+                    /// whether the waiter waits for its key
+                    bool keyed = false;
+                    /// time to resume at (0 = never)
+                    std::uint64_t deadline = 0;
+                };
+
+            protected:
+                /// mutex for all waiters
+                std::mutex mutex;
+                /// waiters of each key in order
+                std::unordered_map<std::uint64_t, std::deque<Waiter*>> waiting;
+                /// waiters with a deadline, ordered by their deadlines
+                std::set<std::pair<std::uint64_t, Waiter*>> timers;
+                /// waiters that were notified but not resumed, yet
+                std::vector<Waiter*> ready;
+                /// number of keyed waiters (checked without locking)
+                std::atomic<std::size_t> keyed;
+
+                /// Remove a waiter from its key (lock must be held)
+                void unkey(Waiter * waiter) {
+                    auto list = this->waiting.find(waiter->key);
+                    if (list == this->waiting.end()) {
+                        return;
+                    }
+                    for (auto w = list->second.begin();
+                         w != list->second.end(); w++) {
+                        if (*w == waiter) {
+                            list->second.erase(w);
+                            this->keyed--;
+                            break;
+                        }
+                    }
+                    if (list->second.empty()) {
+                        this->waiting.erase(list);
+                    }
+                }
+
+                /// Resume waiters outside the lock
+                static void resume(std::vector<Waiter*> const & waiters) {
+                    for (auto w = waiters.begin(); w != waiters.end(); w++) {
+                        (*w)->handle.resume();
+                    }
+                }
+
+            public:
+                /// Constructor
+                Scheduler()
+                    : keyed(0) {
+                }
+
+                /// Add a suspended coroutine
+                /**
+                 * The coroutine is not added if `blocked` returns false; it
+                 *  is checked while holding the lock, so a notification
+                 *  cannot be missed between checking and adding.
+                 *  @param waiter: waiter of the suspended coroutine
+                 *  @param blocked: whether the coroutine needs to wait (or
+                 *      empty)
+                 *  @param earliest: set to true if the waiter's deadline is
+                 *      earlier than all others
+                 *  @return false if the coroutine was not added
+                 */
+                bool wait(Waiter & waiter,
+                          std::function<bool()> const & blocked,
+                          bool & earliest) {
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    earliest = false;
+                    if (blocked && !blocked()) {
+                        return false;
+                    }
+                    if (waiter.keyed) {
+                        this->waiting[waiter.key].push_back(&waiter);
+                        this->keyed++;
+                    }
+                    if (waiter.deadline > 0) {
+                        earliest = (this->timers.empty()
+                            || waiter.deadline < this->timers.begin()->first);
+                        this->timers.emplace(waiter.deadline, &waiter);
+                    }
+                    return true;
+                }
+
+                /// Resume the first waiter of a key with an object
+                /**
+                 * The waiter is resumed by the calling thread before this
+                 *  returns, so it can wait for the next object in time.
+                 *  @param key: key of the object
+                 *  @param object: object to copy into the waiter's result
+                 *  @return false if nobody waited for the key
+                 */
+                bool deliver(std::uint64_t const key, T const & object) {
+                    if (this->keyed == 0) {
+                        return false;
+                    }
+                    Waiter * waiter;
+                    {
+                        std::lock_guard<std::mutex> lock(this->mutex);
+                        auto list = this->waiting.find(key);
+                        if (list == this->waiting.end()) {
+                            return false;
+                        }
+                        waiter = list->second.front();
+                        this->unkey(waiter);
+                        if (waiter->deadline > 0) {
+                            this->timers.erase(std::make_pair(
+                                waiter->deadline, waiter));
+                        }
+                    }
+                    waiter->result = object;
+                    waiter->handle.resume();
+                    return true;
+                }
+
+                /// Mark all waiters of matching keys to be resumed by `run`
+                /**
+                 *  @param match: returns whether a key is notified
+                 *  @return false if no waiter was notified
+                 */
+                template <typename Predicate>
+                bool notifyIf(Predicate match) {
+                    if (this->keyed == 0) {
+                        return false;
+                    }
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    bool found = false;
+                    for (auto list = this->waiting.begin();
+                         list != this->waiting.end();) {
+                        if (!match(list->first)) {
+                            list++;
+                            continue;
+                        }
+                        for (auto w = list->second.begin();
+                             w != list->second.end(); w++) {
+                            if ((*w)->deadline > 0) {
+                                this->timers.erase(std::make_pair(
+                                    (*w)->deadline, *w));
+                            }
+                            this->ready.push_back(*w);
+                            this->keyed--;
+                        }
+                        list = this->waiting.erase(list);
+                        found = true;
+                    }
+                    return found;
+                }
+
+                /// Mark all waiters of a key to be resumed by `run`
+                /**
+                 *  @param key: key to notify
+                 *  @return false if no waiter was notified
+                 */
+                inline bool notify(std::uint64_t const key) {
+                    return this->notifyIf([key](std::uint64_t const k) {
+                        return k == key;
+                    });
+                }
+
+                /// Resume notified waiters and those whose deadline passed
+                /**
+                 *  @param time: current timestamp (see `now`)
+                 *  @return number of resumed waiters
+                 */
+                std::size_t run(std::uint64_t const time) {
+                    std::vector<Waiter*> due;
+                    {
+                        std::lock_guard<std::mutex> lock(this->mutex);
+                        due.swap(this->ready);
+                        while (!this->timers.empty()
+                               && this->timers.begin()->first <= time) {
+                            auto waiter = this->timers.begin()->second;
+                            this->timers.erase(this->timers.begin());
+                            if (waiter->keyed) {
+                                this->unkey(waiter);
+                            }
+                            due.push_back(waiter);
+                        }
+                    }
+                    resume(due);
+                    return due.size();
+                }
+
+                /// Resume all waiters with an empty result
+                void cancel() {
+                    std::vector<Waiter*> due;
+                    {
+                        std::lock_guard<std::mutex> lock(this->mutex);
+                        due.swap(this->ready);
+                        for (auto list = this->waiting.begin();
+                             list != this->waiting.end(); list++) {
+                            due.insert(due.end(), list->second.begin(),
+                                       list->second.end());
+                        }
+                        for (auto t = this->timers.begin();
+                             t != this->timers.end(); t++) {
+                            if (!t->second->keyed) {
+                                due.push_back(t->second);
+                            }
+                        }
+                        this->waiting.clear();
+                        this->timers.clear();
+                        this->keyed = 0;
+                    }
+                    resume(due);
+                }
+
+                /// Returns the time `run` needs to be called at
+                /**
+                 *  @return timestamp (see `now`), 1 if waiters were notified
+                 *      or 0 if nobody waits for a deadline
+                 */
+                std::uint64_t next() {
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    if (!this->ready.empty()) {
+                        return 1;
+                    }
+                    return this->timers.empty()
+                        ? 0 : this->timers.begin()->first;
+                }
+        };
+
+        /// Awaitable suspending a coroutine at a scheduler
+        /**
+         * The awaited result is empty if the waiter was resumed without an
+         *  object (timeout, notification or cancellation).
+         */
+        template <typename T>
+        class Awaiter {
+            public:
+                /// scheduler to wait at (NULL = do not suspend)
+                Scheduler<T> * scheduler;
+                /// state of the suspended coroutine
+                typename Scheduler<T>::Waiter waiter;
+                /// whether the coroutine still needs to wait (or empty)
+                std::function<bool()> blocked;
+                /// called after the coroutine was suspended, with whether its
+                /// deadline is the earliest of the scheduler (or empty)
+                std::function<void(bool)> suspended;
+
+                /// Constructor
+                /**
+                 *  @param scheduler: scheduler to wait at (NULL = ready)
+                 */
+                explicit Awaiter(Scheduler<T> * scheduler)
+                    : scheduler(scheduler) {
+                }
+
+                /// Wait for a key
+                inline Awaiter & on(std::uint64_t const key) {
+                    this->waiter.keyed = true;
+                    this->waiter.key = key;
+                    return *this;
+                }
+
+                /// Wait at most until a timeout passed (FOREVER = no limit)
+                inline Awaiter & within(std::chrono::milliseconds const
+                                        timeout) {
+                    if (timeout != FOREVER) {
+                        this->waiter.deadline = now() + std::uint64_t(
+                            std::chrono::duration_cast<
+                                std::chrono::nanoseconds>(timeout).count());
+                    }
+                    return *this;
+                }
+
+                inline bool await_ready() const noexcept {
+                    return (this->scheduler == NULL);
+                }
+
+                bool await_suspend(std::coroutine_handle<> handle) {
+                    this->waiter.handle = handle;
+                    // The coroutine might be resumed (and this awaiter be
+                    // destroyed) as soon as it was added
+                    auto suspended = this->suspended;
+                    bool earliest = false;
+                    if (!this->scheduler->wait(this->waiter, this->blocked,
+                                               earliest)) {
+                        return false;
+                    }
+                    if (suspended) {
+                        suspended(earliest);
+                    }
+                    return true;
+                }
+
+                inline std::optional<T> await_resume() {
+                    return std::move(this->waiter.result);
+                }
+        };
+
+    }
+
+}
+
+#endif // NET_USE_COROUTINES
+
+#endif // NET_COROUTINE_INCLUDE_GUARD
@@ -0,0 +1,282 @@
+/*
+Copyright (c) 2013 Christian Glöckner <cgloeckner@freenet.de>
+
+This file is part of the networking module:
+    https://github.com/cgloeckner/networking
+
+It offers a tcp-based server-client framework for games and other software.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+#ifndef NET_FRAME_INCLUDE_GUARD
+#define NET_FRAME_INCLUDE_GUARD
+
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+#include <SFML/Network.hpp>
+
+#include <net/profile.hpp>
+
+/// Initial size of each connection's receive buffer
+#ifndef NET_RECEIVE_BUFFER
+#define NET_RECEIVE_BUFFER 16384
+#endif
+
+/// Maximum size of a received frame (larger frames break the connection)
+#ifndef NET_MAX_FRAME
+#define NET_MAX_FRAME (16u << 20)
+#endif
+
+static_assert(NET_MAX_FRAME < (1u << 28),
+              "NET_MAX_FRAME must leave the upper 4 bits for frame flags");
+
+namespace net {
+
+    namespace utils {
+
+        /// Encoded message ready for sending
+        /**
+         * A frame holds a packet and its header in the same format SFML uses
+         *  to send packets: a 32-bit big-endian size followed by the packet's
+         *  data. The upper 4 bits of the size are reserved for flags, which
+         *  are never set for frames holding protocol objects. Objects are
+         *  packed directly into the frame's packet, so the data is not copied
+         *  again. Frames are immutable after they were sealed, so a single
+         *  frame can be shared by the outgoing queues of many workers.
+         */
+        class Frame {
+            protected:
+                /// encoded size of the packet
+                char prefix[4];
+                /// packet holding the data
+                sf::Packet packet;
+#ifdef NET_PROFILE
+                /// time the frame was created (when the object was pushed)
+                std::uint64_t stamp;
+#endif
+
+            public:
+                /// Size of the frame header
+                static std::size_t const HEADER = 4;
+                /// Header bits used for flags
+                static std::uint32_t const FLAGS = 0xF0000000u;
+                /// Flag of frames used by the library (see <net/session.hpp>)
+                static std::uint32_t const CONTROL = 0x80000000u;
+                /// Flag of frames belonging to a remote call (see <net/rpc.hpp>)
+                static std::uint32_t const CALL = 0x40000000u;
+                /// Flag of frames with deflated data (see <net/compress.hpp>)
+                static std::uint32_t const COMPRESSED = 0x20000000u;
+
+                /// Constructor
+                Frame() {
+                    this->seal();
+#ifdef NET_PROFILE
+                    this->stamp = now();
+#endif
+                }
+
+                /// Returns the packet to write the data to
+                inline sf::Packet & body() {
+                    return this->packet;
+                }
+
+                /// Write the header after the packet was filled
+                /**
+                 *  @param flags: flags to store inside the header
+                 */
+                void seal(std::uint32_t const flags=0) {
+                    std::uint32_t size = std::uint32_t(
+                        this->packet.getDataSize()) | (flags & FLAGS);
+                    this->prefix[0] = char((size >> 24) & 0xFF);
+                    this->prefix[1] = char((size >> 16) & 0xFF);
+                    this->prefix[2] = char((size >> 8) & 0xFF);
+                    this->prefix[3] = char(size & 0xFF);
+                }
+
+                /// Returns the encoded header
+                inline char const * header() const {
+                    return this->prefix;
+                }
+
+                /// Returns the flags stored inside the header
+                inline std::uint32_t flags() const {
+                    return (std::uint32_t(static_cast<unsigned char>(
+                        this->prefix[0])) << 24) & FLAGS;
+                }
+
+                /// Returns the packet's data
+                inline char const * data() const {
+                    return static_cast<char const *>(this->packet.getData());
+                }
+
+                /// Returns the number of encoded bytes (including the header)
+                inline std::size_t size() const {
+                    return HEADER + this->packet.getDataSize();
+                }
+
+#ifdef NET_PROFILE
+                /// Returns the time the frame was created
+                inline std::uint64_t created() const {
+                    return this->stamp;
+                }
+#endif
+        };
+
+        /// Reference-counted, immutable frame
+        typedef std::shared_ptr<Frame const> FramePtr;
+
+        /// Encode a protocol object into a frame
+        /**
+         * The object is serialized once using its `pack` method.
+         *  @param object: object to encode
+         *  @return frame or an empty pointer if packing failed
+         */
+        template <typename Protocol>
+        FramePtr encode(Protocol & object) {
+            auto frame = std::make_shared<Frame>();
+            if (!object.pack(frame->body())) {
+                return FramePtr();
+            }
+            frame->seal();
+            return frame;
+        }
+
+        /// Receive buffer of a connection
+        /**
+         * Each call of `receive` reads as many bytes as available by a single
+         *  socket operation. Afterwards, all complete frames can be taken by
+         *  `next` without copying them. Their data is valid until the next
+         *  call of `receive`. Incomplete frames are kept until the rest was
+         *  received.
+         */
+        class FrameReader {
+            protected:
+                /// received bytes
+                std::vector<char> buffer;
+                /// position of the first byte that was not taken, yet
+                std::size_t begin;
+                /// position behind the last received byte
+                std::size_t end;
+
+                /// Returns the raw header of the frame at `begin`
+                inline std::uint32_t prefix() const {
+                    auto data = reinterpret_cast<unsigned char const *>(
+                        this->buffer.data() + this->begin);
+                    return (std::uint32_t(data[0]) << 24)
+                         | (std::uint32_t(data[1]) << 16)
+                         | (std::uint32_t(data[2]) << 8)
+                         | std::uint32_t(data[3]);
+                }
+
+                /// Returns the size of the frame at `begin` (incl. header)
+                inline std::size_t peek() const {
+                    return Frame::HEADER
+                         + std::size_t(this->prefix() & ~Frame::FLAGS);
+                }
+
+            public:
+                /// Constructor
+                /**
+                 *  @param capacity: initial size of the buffer
+                 */
+                FrameReader(std::size_t const capacity=NET_RECEIVE_BUFFER)
+                    : buffer(capacity)
+                    , begin(0)
+                    , end(0) {
+                }
+
+                /// Receive as many bytes as available
+                /**
+                 * The buffer grows if the next frame does not fit into it.
+                 *  @param link: non-blocking TCP socket
+                 *  @return status of the socket operation, or Error if the
+                 *      next frame exceeds NET_MAX_FRAME
+                 */
+                sf::Socket::Status receive(sf::TcpSocket & link) {
+                    // Move the incomplete frame to the front
+                    if (this->begin > 0) {
+                        std::copy(this->buffer.begin() + this->begin,
+                                  this->buffer.begin() + this->end,
+                                  this->buffer.begin());
+                        this->end -= this->begin;
+                        this->begin = 0;
+                    }
+                    // Make room for the incomplete frame
+                    std::size_t required = this->buffer.size();
+                    if (this->end >= Frame::HEADER) {
+                        required = std::max(required, this->peek());
+                    }
+                    if (required > NET_MAX_FRAME + Frame::HEADER) {
+                        return sf::Socket::Error;
+                    }
+                    if (this->end == this->buffer.size()) {
+                        required = std::max(required, 2 * this->end);
+                    }
+                    if (required > this->buffer.size()) {
+                        this->buffer.resize(required);
+                    }
+                    std::size_t received = 0;
+                    auto status = link.receive(this->buffer.data() + this->end,
+                                               this->buffer.size() - this->end,
+                                               received);
+                    this->end += received;
+                    return status;
+                }
+
+                /// Take the next complete frame
+                /**
+                 *  @param data: set to the frame's data (without header)
+                 *  @param size: set to the number of bytes of the data
+                 *  @param flags: set to the flags of the frame's header
+                 *  @return false if no complete frame is left
+                 */
+                bool next(char const * & data, std::size_t & size,
+                          std::uint32_t & flags) {
+                    if (this->end - this->begin < Frame::HEADER) {
+                        return false;
+                    }
+                    auto total = this->peek();
+                    if (this->end - this->begin < total) {
+                        return false;
+                    }
+                    flags = this->prefix() & Frame::FLAGS;
+                    data = this->buffer.data() + this->begin + Frame::HEADER;
+                    size = total - Frame::HEADER;
+                    this->begin += total;
+                    return true;
+                }
+
+                /// Drop all received bytes
+                inline void clear() {
+                    this->begin = 0;
+                    this->end = 0;
+                }
+        };
+
+    }
+
+}
+
+#endif // NET_FRAME_INCLUDE_GUARD
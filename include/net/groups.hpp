@@ -0,0 +1,169 @@
+/*
+Copyright (c) 2013 Christian Glöckner <cgloeckner@freenet.de>
+
+This file is part of the networking module:
+    https://github.com/cgloeckner/networking
+
+It offers a tcp-based server-client framework for games and other software.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#ifndef NET_GROUPS_INCLUDE_GUARD
+#define NET_GROUPS_INCLUDE_GUARD
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <unordered_map>
+
+namespace net {
+
+    namespace utils {
+
+        /// Index of groups with their members
+        /**
+         * Each group stores its members as a sorted array that is never
+         *  modified after publishing. Adding or removing members builds a new
+         *  array and replaces the old one (copy-on-write), so readers iterate
+         *  a snapshot of contiguous memory without holding any lock, while
+         *  the snapshot stays valid even if the group changes meanwhile.
+         *  Writers are serialized; readers only lock to copy the pointer.
+         */
+        template <typename Group, typename Member>
+        class GroupIndex {
+            public:
+                /// Sorted members of a group
+                typedef std::vector<Member> Members;
+                /// Immutable snapshot of a group's members
+                typedef std::shared_ptr<Members const> Snapshot;
+
+            protected:
+                /// Published snapshots keyed by their groups
+                std::unordered_map<Group, Snapshot> groups;
+                /// mutex for accessing the published snapshots
+                mutable std::mutex mutex;
+                /// mutex for serializing modifications
+                std::mutex write_mutex;
+
+                /// Returns the published snapshot of a group (or NULL)
+                Snapshot get(Group const group) const {
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    auto node = this->groups.find(group);
+                    return (node != this->groups.end()) ? node->second
+                                                        : Snapshot();
+                }
+
+                /// Publish a new snapshot of a group
+                void set(Group const group, Snapshot snapshot) {
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    this->groups[group].swap(snapshot);
+                    // the old snapshot is released after unlocking
+                }
+
+                /// Returns the sorted members of a range without duplicates
+                template <typename Iterator>
+                static Members sorted(Iterator begin, Iterator end) {
+                    Members members(begin, end);
+                    std::sort(members.begin(), members.end());
+                    members.erase(std::unique(members.begin(), members.end()),
+                                  members.end());
+                    return members;
+                }
+
+            public:
+                /// Returns the members of a group
+                /**
+                 *  @param group: group to look up
+                 *  @return snapshot or an empty pointer if the group does not
+                 *          exist
+                 */
+                inline Snapshot find(Group const group) const {
+                    return this->get(group);
+                }
+
+                /// Returns whether the group exists
+                inline bool has(Group const group) const {
+                    return (this->get(group) != NULL);
+                }
+
+                /// Add members to a group (created if necessary)
+                /**
+                 *  @param group: group to modify
+                 *  @param begin: first member to add
+                 *  @param end: behind the last member to add
+                 */
+                template <typename Iterator>
+                void insert(Group const group, Iterator begin, Iterator end) {
+                    auto added = sorted(begin, end);
+                    std::lock_guard<std::mutex> lock(this->write_mutex);
+                    auto current = this->get(group);
+                    std::shared_ptr<Members> next(new Members());
+                    if (current == NULL) {
+                        next->swap(added);
+                    } else {
+                        next->reserve(current->size() + added.size());
+                        std::set_union(current->begin(), current->end(),
+                                       added.begin(), added.end(),
+                                       std::back_inserter(*next));
+                    }
+                    this->set(group, std::move(next));
+                }
+
+                /// Remove members from a group
+                /**
+                 * The group is kept even if it becomes empty.
+                 *  @param group: group to modify
+                 *  @param begin: first member to remove
+                 *  @param end: behind the last member to remove
+                 */
+                template <typename Iterator>
+                void erase(Group const group, Iterator begin, Iterator end) {
+                    auto removed = sorted(begin, end);
+                    std::lock_guard<std::mutex> lock(this->write_mutex);
+                    auto current = this->get(group);
+                    if (current == NULL) {
+                        return;
+                    }
+                    std::shared_ptr<Members> next(new Members());
+                    next->reserve(current->size());
+                    std::set_difference(current->begin(), current->end(),
+                                        removed.begin(), removed.end(),
+                                        std::back_inserter(*next));
+                    this->set(group, std::move(next));
+                }
+
+                /// Remove all groups
+                void clear() {
+                    std::lock_guard<std::mutex> lock(this->write_mutex);
+                    std::unordered_map<Group, Snapshot> groups;
+                    this->mutex.lock();
+                    this->groups.swap(groups);
+                    this->mutex.unlock();
+                }
+        };
+
+    }
+
+}
+
+#endif // NET_GROUPS_INCLUDE_GUARD
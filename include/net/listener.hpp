@@ -0,0 +1,102 @@
+/*
+Copyright (c) 2013 Christian Glöckner <cgloeckner@freenet.de>
+
+This file is part of the networking module:
+    https://github.com/cgloeckner/networking
+
+It offers a tcp-based server-client framework for games and other software.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#ifndef NET_LISTENER_INCLUDE_GUARD
+#define NET_LISTENER_INCLUDE_GUARD
+
+#include <cstdint>
+
+#include <SFML/Network.hpp>
+
+// Several listeners can share a port on Linux unless NET_NO_REUSEPORT is
+// defined. The kernel distributes incomming connections among them.
+#if defined(__linux__) && !defined(NET_NO_REUSEPORT)
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#ifdef SO_REUSEPORT
+#define NET_USE_REUSEPORT
+#endif
+#endif
+
+namespace net {
+
+    namespace utils {
+
+#ifdef NET_USE_REUSEPORT
+
+        /// Listen on a port that is shared with other listeners
+        /**
+         * SFML's `listen` cannot set SO_REUSEPORT, so the socket is created,
+         *  bound and put into listening state here. Afterwards it is handed
+         *  over to the given listener through the protected `create`.
+         *  @param listener: listener that will own the socket
+         *  @param port: local port number
+         *  @return true if listening was started
+         */
+        inline bool listenShared(sf::TcpListener & listener,
+                                 std::uint16_t const port) {
+            struct Access: public sf::TcpListener {
+                static void attach(sf::TcpListener & listener,
+                                   sf::SocketHandle const handle) {
+                    void (sf::Socket::*create)(sf::SocketHandle) =
+                        &Access::create;
+                    (listener.*create)(handle);
+                }
+            };
+            listener.close();
+            auto handle = ::socket(PF_INET, SOCK_STREAM, 0);
+            if (handle == -1) {
+                return false;
+            }
+            int yes = 1;
+            sockaddr_in address = sockaddr_in();
+            address.sin_family = AF_INET;
+            address.sin_port = htons(port);
+            address.sin_addr.s_addr = htonl(INADDR_ANY);
+            if (::setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, &yes,
+                             sizeof(yes)) == -1
+                || ::setsockopt(handle, SOL_SOCKET, SO_REUSEPORT, &yes,
+                                sizeof(yes)) == -1
+                || ::bind(handle, reinterpret_cast<sockaddr*>(&address),
+                          sizeof(address)) == -1
+                || ::listen(handle, SOMAXCONN) == -1) {
+                ::close(handle);
+                return false;
+            }
+            Access::attach(listener, handle);
+            return true;
+        }
+
+#endif // NET_USE_REUSEPORT
+
+    }
+
+}
+
+#endif // NET_LISTENER_INCLUDE_GUARD
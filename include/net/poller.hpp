@@ -0,0 +1,212 @@
+/*
+Copyright (c) 2013 Christian Glöckner <cgloeckner@freenet.de>
+
+This file is part of the networking module:
+    https://github.com/cgloeckner/networking
+
+It offers a tcp-based server-client framework for games and other software.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#ifndef NET_POLLER_INCLUDE_GUARD
+#define NET_POLLER_INCLUDE_GUARD
+
+#include <vector>
+#include <cstdint>
+
+#include <SFML/Network.hpp>
+
+// The event-driven reactor is used on Linux unless NET_NO_EPOLL is defined.
+// Other platforms keep the polling network loops.
+#if defined(__linux__) && !defined(NET_NO_EPOLL)
+#define NET_USE_EPOLL
+#endif
+
+#ifdef NET_USE_EPOLL
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+namespace net {
+
+    namespace utils {
+
+        /// Obtain the native handle of a SFML socket
+        /**
+         * SFML keeps `getHandle` protected, so this reaches it through a
+         *  derived helper class. The handle is needed to register sockets at
+         *  the operating system's readiness notification.
+         *  @param socket: SFML socket
+         *  @return native socket handle
+         */
+        inline sf::SocketHandle getHandle(sf::Socket const & socket) {
+            struct Access: public sf::TcpSocket {
+                static sf::SocketHandle of(sf::Socket const & socket) {
+                    return (socket.*(&Access::getHandle))();
+                }
+            };
+            return Access::of(socket);
+        }
+
+#ifdef NET_USE_EPOLL
+
+        /// Readiness notification for sockets
+        /**
+         * This class wraps an epoll instance and an eventfd, which is used to
+         *  wake up a thread that is blocked inside `wait`. Each registered
+         *  socket is identified by a token, which is returned with each
+         *  event. The token `WAKEUP` is reserved for the eventfd.
+         */
+        class Poller {
+            protected:
+                /// epoll instance
+                int epoll;
+                /// eventfd used for wakeups
+                int event;
+
+            public:
+                /// Token reserved for wakeup events
+                static std::uint64_t const WAKEUP = ~std::uint64_t(0);
+
+                /// Single readiness event
+                struct Event {
+                    /// token of the socket
+                    std::uint64_t token;
+                    /// data can be read
+                    bool readable;
+                    /// data can be written
+                    bool writable;
+                    /// remote side hung up or an error occured
+                    bool closed;
+                };
+
+                /// Constructor
+                Poller() {
+                    this->epoll = epoll_create1(EPOLL_CLOEXEC);
+                    this->event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+                    this->add(this->event, WAKEUP);
+                }
+
+                /// Destructor
+                virtual ~Poller() {
+                    ::close(this->event);
+                    ::close(this->epoll);
+                }
+
+                /// Register a socket
+                /**
+                 * The socket is observed for incomming data (level-triggered).
+                 *  @param handle: native socket handle
+                 *  @param token: token to identify the socket's events
+                 *  @return true in case of success
+                 */
+                inline bool add(sf::SocketHandle const handle,
+                                std::uint64_t const token) {
+                    epoll_event ev;
+                    ev.events   = EPOLLIN | EPOLLRDHUP;
+                    ev.data.u64 = token;
+                    return (epoll_ctl(this->epoll, EPOLL_CTL_ADD, handle, &ev)
+                            == 0);
+                }
+
+                /// Change the observed events of a socket
+                /**
+                 *  @param handle: native socket handle
+                 *  @param token: token to identify the socket's events
+                 *  @param writable: also observe whether data can be written
+                 *  @return true in case of success
+                 */
+                inline bool modify(sf::SocketHandle const handle,
+                                   std::uint64_t const token,
+                                   bool const writable) {
+                    epoll_event ev;
+                    ev.events   = EPOLLIN | EPOLLRDHUP;
+                    if (writable) {
+                        ev.events |= EPOLLOUT;
+                    }
+                    ev.data.u64 = token;
+                    return (epoll_ctl(this->epoll, EPOLL_CTL_MOD, handle, &ev)
+                            == 0);
+                }
+
+                /// Unregister a socket
+                /**
+                 * Closed sockets are removed automatically.
+                 *  @param handle: native socket handle
+                 */
+                inline void remove(sf::SocketHandle const handle) {
+                    epoll_ctl(this->epoll, EPOLL_CTL_DEL, handle, NULL);
+                }
+
+                /// Wake up the thread that is waiting
+                /**
+                 * This is thread-safe and can be called as often as necessary.
+                 *  Multiple wakeups are merged into a single event.
+                 */
+                inline void wakeup() {
+                    std::uint64_t one = 1;
+                    ssize_t written = ::write(this->event, &one, sizeof(one));
+                    (void)written; // counter overflow is impossible here
+                }
+
+                /// Wait for events
+                /**
+                 * This blocks until at least one event occured or the timeout
+                 *  expired. A wakeup is reported as an event with the token
+                 *  `WAKEUP` and is reset automatically.
+                 *  @param events: vector to store the events in
+                 *  @param timeout: timeout in milliseconds (-1 = infinite)
+                 *  @return number of events
+                 */
+                std::size_t wait(std::vector<Event> & events,
+                                 int const timeout=-1) {
+                    epoll_event buffer[64];
+                    events.clear();
+                    int n = epoll_wait(this->epoll, buffer, 64, timeout);
+                    for (int i = 0; i < n; i++) {
+                        Event e;
+                        e.token    = buffer[i].data.u64;
+                        e.readable = (buffer[i].events & EPOLLIN) != 0;
+                        e.writable = (buffer[i].events & EPOLLOUT) != 0;
+                        e.closed   = (buffer[i].events
+                                      & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                                     != 0;
+                        if (e.token == WAKEUP) {
+                            // reset eventfd counter
+                            std::uint64_t counter;
+                            ssize_t got = ::read(this->event, &counter,
+                                                 sizeof(counter));
+                            (void)got;
+                        }
+                        events.push_back(e);
+                    }
+                    return events.size();
+                }
+        };
+
+#endif // NET_USE_EPOLL
+
+    }
+
+}
+
+#endif // NET_POLLER_INCLUDE_GUARD
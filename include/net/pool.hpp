@@ -0,0 +1,171 @@
+/*
+Copyright (c) 2013 Christian Glöckner <cgloeckner@freenet.de>
+
+This file is part of the networking module:
+    https://github.com/cgloeckner/networking
+
+It offers a tcp-based server-client framework for games and other software.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#ifndef NET_POOL_INCLUDE_GUARD
+#define NET_POOL_INCLUDE_GUARD
+
+#include <mutex>
+#include <memory>
+#include <vector>
+
+/// Default number of spare objects kept by a pool (0 = no recycling)
+#ifndef NET_POOL_CAPACITY
+#define NET_POOL_CAPACITY 0
+#endif
+
+namespace net {
+
+    namespace utils {
+
+        template <typename T>
+        class ObjectPool;
+
+        /// Returns objects to their pool
+        template <typename T>
+        struct Recycler {
+            /// pool the object belongs to
+            ObjectPool<T> * pool;
+
+            Recycler(ObjectPool<T> * pool=NULL)
+                : pool(pool) {
+            }
+
+            inline void operator()(T * object) const {
+                this->pool->recycle(object);
+            }
+        };
+
+        /// Handle of a pooled object
+        /**
+         * The object is returned to its pool when the handle is destroyed.
+         *  Handles are move-only and must not outlive their pool.
+         */
+        template <typename T>
+        using Pooled = std::unique_ptr<T, Recycler<T>>;
+
+        /// Pool of recycled objects
+        /**
+         * Objects that are released are kept for reuse instead of deleting
+         *  them, so their members keep the capacity of their strings and
+         *  vectors. Recycled objects are reset by their `clear` method
+         *  before they are handed out again. The pool keeps at most
+         *  `capacity` spare objects; further objects are deleted.
+         */
+        template <typename T>
+        class ObjectPool {
+            protected:
+                /// mutex for thread-safety of acquire/recycle
+                std::mutex mutex;
+                /// unused objects
+                std::vector<T*> spare;
+                /// maximum number of unused objects
+                std::size_t capacity;
+
+            public:
+                /// Constructor
+                /**
+                 *  @param capacity: maximum number of spare objects
+                 */
+                ObjectPool(std::size_t const capacity=NET_POOL_CAPACITY)
+                    : capacity(capacity) {
+                }
+
+                /// Destructor
+                /**
+                 * All handles must have been released before.
+                 */
+                virtual ~ObjectPool() {
+                    for (auto object = this->spare.begin();
+                         object != this->spare.end(); object++) {
+                        delete *object;
+                    }
+                }
+
+                /// Take a spare object or create a new one
+                /**
+                 *  @return handle of the object
+                 */
+                Pooled<T> acquire() {
+                    T * object = NULL;
+                    this->mutex.lock();
+                    if (!this->spare.empty()) {
+                        object = this->spare.back();
+                        this->spare.pop_back();
+                    }
+                    this->mutex.unlock();
+                    if (object == NULL) {
+                        object = new T();
+                    } else {
+                        // Drop the values of the last use
+                        object->clear();
+                    }
+                    return Pooled<T>(object, Recycler<T>(this));
+                }
+
+                /// Keep an object for reuse (or delete it)
+                /**
+                 *  @param object: object that is not used anymore
+                 */
+                void recycle(T * object) {
+                    this->mutex.lock();
+                    bool keep = (this->spare.size() < this->capacity);
+                    if (keep) {
+                        this->spare.push_back(object);
+                    }
+                    this->mutex.unlock();
+                    if (!keep) {
+                        delete object;
+                    }
+                }
+
+                /// Change the maximum number of spare objects
+                /**
+                 *  @param capacity: maximum number of spare objects (0 = do
+                 *      not recycle objects at all)
+                 */
+                void setCapacity(std::size_t const capacity) {
+                    std::vector<T*> surplus;
+                    this->mutex.lock();
+                    this->capacity = capacity;
+                    while (this->spare.size() > capacity) {
+                        surplus.push_back(this->spare.back());
+                        this->spare.pop_back();
+                    }
+                    this->mutex.unlock();
+                    for (auto object = surplus.begin();
+                         object != surplus.end(); object++) {
+                        delete *object;
+                    }
+                }
+        };
+
+    }
+
+}
+
+#endif // NET_POOL_INCLUDE_GUARD
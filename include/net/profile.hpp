@@ -0,0 +1,231 @@
+/*
+Copyright (c) 2013 Christian Glöckner <cgloeckner@freenet.de>
+
+This file is part of the networking module:
+    https://github.com/cgloeckner/networking
+
+It offers a tcp-based server-client framework for games and other software.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#ifndef NET_PROFILE_INCLUDE_GUARD
+#define NET_PROFILE_INCLUDE_GUARD
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Latencies of the message pipeline are only measured if NET_PROFILE is
+// defined. Otherwise the histograms stay empty.
+
+namespace net {
+
+    /// Stage of the message pipeline
+    enum class Stage {
+        /// From reading the bytes until the object was queued for handling
+        Receive,
+        /// Waiting inside the incomming queue until a handler started
+        Incoming,
+        /// Running the callback
+        Handler,
+        /// From pushing the object until it was written to the socket
+        Outgoing
+    };
+
+    namespace utils {
+
+        /// Returns a monotonic timestamp in nanoseconds
+        inline std::uint64_t now() {
+            return std::uint64_t(std::chrono::duration_cast<
+                std::chrono::nanoseconds>(std::chrono::steady_clock::now()
+                    .time_since_epoch()).count());
+        }
+
+        /// Histogram of durations with logarithmic buckets
+        /**
+         * Each power of two is split into 2^SUB_BITS linear buckets, so each
+         *  recorded value is accurate to 1/2^SUB_BITS (12.5%) while the
+         *  whole 64-bit range fits into a fixed array. Recording is a
+         *  relaxed atomic increment, so any thread can record without
+         *  locking. Reading while recording yields a slightly inconsistent
+         *  but valid view.
+         */
+        class Histogram {
+            public:
+                /// Number of bits splitting each power of two
+                static std::size_t const SUB_BITS = 3;
+                /// Number of buckets
+                static std::size_t const BUCKETS = 64 << SUB_BITS;
+
+            protected:
+                /// number of values per bucket
+                std::atomic<std::uint64_t> counts[BUCKETS];
+                /// number of values
+                std::atomic<std::uint64_t> total;
+                /// sum of all values
+                std::atomic<std::uint64_t> sum;
+                /// highest value
+                std::atomic<std::uint64_t> highest;
+
+                /// Returns the bucket of a value
+                static inline std::size_t indexOf(std::uint64_t const value) {
+                    if (value < (1u << SUB_BITS)) {
+                        return std::size_t(value);
+                    }
+#if defined(__GNUC__)
+                    std::size_t msb = 63 - __builtin_clzll(value);
+#else
+                    std::size_t msb = 0;
+                    while ((value >> msb) > 1) {
+                        msb++;
+                    }
+#endif
+                    auto shift = msb - SUB_BITS;
+                    return ((shift + 1) << SUB_BITS)
+                        + std::size_t((value >> shift) & ((1u << SUB_BITS) - 1));
+                }
+
+                /// Returns the highest value of a bucket
+                static inline std::uint64_t valueOf(std::size_t const index) {
+                    if (index < (1u << SUB_BITS)) {
+                        return index;
+                    }
+                    auto shift = (index >> SUB_BITS) - 1;
+                    std::uint64_t mantissa = (index & ((1u << SUB_BITS) - 1))
+                        | (1u << SUB_BITS);
+                    return ((mantissa + 1) << shift) - 1;
+                }
+
+            public:
+                /// Constructor
+                Histogram() {
+                    this->reset();
+                }
+
+                /// Record a value
+                /**
+                 *  @param value: duration in nanoseconds
+                 */
+                inline void record(std::uint64_t const value) {
+                    this->counts[indexOf(value)].fetch_add(1,
+                        std::memory_order_relaxed);
+                    this->total.fetch_add(1, std::memory_order_relaxed);
+                    this->sum.fetch_add(value, std::memory_order_relaxed);
+                    auto high = this->highest.load(std::memory_order_relaxed);
+                    while (value > high && !this->highest.compare_exchange_weak(
+                        high, value, std::memory_order_relaxed)) {}
+                }
+
+                /// Remove all values
+                void reset() {
+                    for (std::size_t i = 0; i < BUCKETS; i++) {
+                        this->counts[i].store(0, std::memory_order_relaxed);
+                    }
+                    this->total.store(0, std::memory_order_relaxed);
+                    this->sum.store(0, std::memory_order_relaxed);
+                    this->highest.store(0, std::memory_order_relaxed);
+                }
+
+                /// Returns the number of values
+                inline std::uint64_t count() const {
+                    return this->total.load(std::memory_order_relaxed);
+                }
+
+                /// Returns the mean value (0 if empty)
+                inline std::uint64_t mean() const {
+                    auto n = this->count();
+                    return (n > 0) ? this->sum.load(std::memory_order_relaxed)
+                        / n : 0;
+                }
+
+                /// Returns the highest value
+                inline std::uint64_t max() const {
+                    return this->highest.load(std::memory_order_relaxed);
+                }
+
+                /// Returns the value below which the given ratio of values is
+                /**
+                 *  @param ratio: e.g. 0.99 for the 99th percentile
+                 *  @return upper value of the bucket (0 if empty)
+                 */
+                std::uint64_t percentile(double const ratio) const {
+                    std::uint64_t n = 0;
+                    std::uint64_t counts[BUCKETS];
+                    for (std::size_t i = 0; i < BUCKETS; i++) {
+                        counts[i] = this->counts[i].load(
+                            std::memory_order_relaxed);
+                        n += counts[i];
+                    }
+                    if (n == 0) {
+                        return 0;
+                    }
+                    auto rank = std::uint64_t(ratio * double(n));
+                    if (rank >= n) {
+                        rank = n - 1;
+                    }
+                    std::uint64_t seen = 0;
+                    for (std::size_t i = 0; i < BUCKETS; i++) {
+                        seen += counts[i];
+                        if (seen > rank) {
+                            auto value = valueOf(i);
+                            auto high = this->max();
+                            return (value < high) ? value : high;
+                        }
+                    }
+                    return this->max();
+                }
+        };
+
+        /// Latency histograms of all stages of the message pipeline
+        class Profile {
+            protected:
+                /// histograms indexed by their stage
+                Histogram stages[4];
+
+            public:
+                /// Record the duration of a stage
+                inline void record(Stage const stage, std::uint64_t const ns) {
+                    this->stages[std::size_t(stage)].record(ns);
+                }
+
+                /// Record the time since the given timestamp
+                inline void since(Stage const stage, std::uint64_t const start) {
+                    this->record(stage, now() - start);
+                }
+
+                /// Returns the histogram of a stage
+                inline Histogram const & operator[](Stage const stage) const {
+                    return this->stages[std::size_t(stage)];
+                }
+
+                /// Remove all values
+                void reset() {
+                    for (std::size_t i = 0; i < 4; i++) {
+                        this->stages[i].reset();
+                    }
+                }
+        };
+
+    }
+
+}
+
+#endif // NET_PROFILE_INCLUDE_GUARD
@@ -0,0 +1,631 @@
+/*
+Copyright (c) 2013 Christian Glöckner <cgloeckner@freenet.de>
+
+This file is part of the networking module:
+    https://github.com/cgloeckner/networking
+
+It offers a tcp-based server-client framework for games and other software.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+#ifndef NET_RINGQUEUE_INCLUDE_GUARD
+#define NET_RINGQUEUE_INCLUDE_GUARD
+
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+#include <net/common.hpp>
+
+/// Default capacity of the bounded ring queues
+#ifndef NET_RING_CAPACITY
+#define NET_RING_CAPACITY 16384
+#endif
+
+namespace net {
+
+    namespace utils {
+
+        /// Assumed size of a cache line
+        std::size_t const CACHE_LINE = 64;
+
+        /// Round up to the next power of two
+        inline std::size_t nextPowerOfTwo(std::size_t value) {
+            std::size_t result = 1;
+            while (result < value) {
+                result <<= 1;
+            }
+            return result;
+        }
+
+        /// Lock-free, Bounded Single-Producer / Single-Consumer Queue
+        /**
+         * This class provides a fifo ring buffer which can be used by exactly
+         *  one pushing and one popping thread at the same time. Objects are
+         *  moved in and out of preallocated slots, so no allocation happens
+         *  while pushing or popping. Head and tail are kept on seperate cache
+         *  lines to avoid false sharing between producer and consumer.
+         *  The queue is bounded: `push` waits while the queue is full, use
+         *  `tryPush` to avoid this.
+         */
+        template <typename Data>
+        class SpscQueue {
+            protected:
+                /// capacity - 1 (capacity is a power of two)
+                std::size_t mask;
+                /// preallocated slots
+                std::unique_ptr<Data[]> slots;
+                /// padding
+                char pad0[CACHE_LINE];
+                /// next slot to pop (written by consumer)
+                std::atomic<std::size_t> head;
+                /// consumer's copy of the tail
+                std::size_t tail_cache;
+                /// padding
+                char pad1[CACHE_LINE];
+                /// next slot to push (written by producer)
+                std::atomic<std::size_t> tail;
+                /// producer's copy of the head
+                std::size_t head_cache;
+                /// padding
+                char pad2[CACHE_LINE];
+                /// signaled if data was pushed or the queue was closed
+                Signal filled;
+                /// signaled if a consumer found the queue empty
+                Signal drained;
+                /// whether the queue was closed
+                std::atomic<bool> closed;
+                /// whether the next wait returns without data
+                std::atomic<bool> interrupted;
+
+            public:
+                /// Constructor
+                /**
+                 *  @param capacity: minimum number of slots (rounded up to
+                 *      the next power of two)
+                 */
+                SpscQueue(std::size_t const capacity=NET_RING_CAPACITY)
+                    : mask(nextPowerOfTwo(capacity < 2 ? 2 : capacity) - 1)
+                    , slots(new Data[mask + 1])
+                    , head(0)
+                    , tail_cache(0)
+                    , tail(0)
+                    , head_cache(0)
+                    , closed(false)
+                    , interrupted(false) {
+                }
+                /// Destructor
+                virtual ~SpscQueue() {
+                }
+                /// Clear all data
+                /**
+                 * This must be called by the consumer.
+                 */
+                inline void clear() {
+                    Data tmp;
+                    while (this->pop(tmp)) {}
+                }
+                /// Try to push data to the queue
+                /**
+                 * This moves the given object to the queue if a slot is free.
+                 *  @param data: object
+                 *  @return false if the queue is full
+                 */
+                template <typename T>
+                inline bool tryPush(T && data) {
+                    auto t = this->tail.load(std::memory_order_relaxed);
+                    if (t - this->head_cache > this->mask) {
+                        this->head_cache = this->head.load(
+                            std::memory_order_acquire);
+                        if (t - this->head_cache > this->mask) {
+                            return false;
+                        }
+                    }
+                    this->slots[t & this->mask] = std::forward<T>(data);
+                    this->tail.store(t + 1, std::memory_order_release);
+                    this->filled.notify();
+                    return true;
+                }
+                /// Push data to the queue
+                /**
+                 * This pushs a given object to the queue. If the queue is full
+                 *  this waits until the consumer popped an object.
+                 *  @param data: object
+                 */
+                inline void push(Data const & data) {
+                    while (!this->tryPush(data)) {
+                        std::this_thread::yield();
+                    }
+                }
+                inline void push(Data && data) {
+                    while (!this->tryPush(std::move(data))) {
+                        std::this_thread::yield();
+                    }
+                }
+                /// Construct an object and push it to the queue
+                /**
+                 * The slots are constructed in advance, so the object is
+                 *  moved into the next free slot.
+                 *  @param args: arguments for the object's constructor
+                 */
+                template <typename... Args>
+                inline void emplace(Args &&... args) {
+                    this->push(Data(std::forward<Args>(args)...));
+                }
+                /// Pop object from queue.
+                /**
+                 * This moves the next object out of the queue.
+                 *  @param result: object to move the data to
+                 *  @return bool describing data was obtained or not
+                 */
+                inline bool pop(Data & result) {
+                    auto h = this->head.load(std::memory_order_relaxed);
+                    if (h == this->tail_cache) {
+                        this->tail_cache = this->tail.load(
+                            std::memory_order_acquire);
+                        if (h == this->tail_cache) {
+                            this->drained.notify();
+                            return false;
+                        }
+                    }
+                    result = std::move(this->slots[h & this->mask]);
+                    this->head.store(h + 1, std::memory_order_release);
+                    return true;
+                }
+                /// Pop a batch of objects
+                /**
+                 * This moves up to `limit` objects out of the queue and passes
+                 *  each to the given handler (called as `handler(Data &&)`).
+                 *  The slots are released with a single atomic store.
+                 *  @param handler: callable to process each object
+                 *  @param limit: maximum number of objects
+                 *  @return number of objects that were popped
+                 */
+                template <typename Handler>
+                std::size_t drain(Handler handler, std::size_t const limit=
+                                  std::numeric_limits<std::size_t>::max()) {
+                    auto h = this->head.load(std::memory_order_relaxed);
+                    this->tail_cache = this->tail.load(
+                        std::memory_order_acquire);
+                    std::size_t n = this->tail_cache - h;
+                    if (n > limit) {
+                        n = limit;
+                    }
+                    for (std::size_t i = 0; i < n; i++) {
+                        handler(std::move(this->slots[(h + i) & this->mask]));
+                    }
+                    this->head.store(h + n, std::memory_order_release);
+                    if (n == 0) {
+                        this->drained.notify();
+                    }
+                    return n;
+                }
+                /// Wait for an object and pop it
+                /**
+                 * This blocks until an object was pushed, the queue was
+                 *  closed or the timeout expired.
+                 *  @param result: object to move the data to
+                 *  @param timeout: maximum time to wait
+                 *  @return bool describing data was obtained or not
+                 */
+                bool waitPop(Data & result,
+                             std::chrono::milliseconds const timeout=FOREVER) {
+                    auto ready = [this]() {
+                        return !this->isEmpty() || this->closed.load()
+                            || this->interrupted.load();
+                    };
+                    while (!this->pop(result)) {
+                        if (this->closed.load()
+                            || this->interrupted.exchange(false)
+                            || !this->filled.wait(ready, timeout)) {
+                            // closed, interrupted or timed out
+                            return this->pop(result);
+                        }
+                    }
+                    return true;
+                }
+                /// Wait for objects and pop a batch of them
+                /**
+                 * This blocks like `waitPop`, but moves up to `limit` objects
+                 *  to the given vector.
+                 *  @param result: vector to append the objects to
+                 *  @param limit: maximum number of objects
+                 *  @param timeout: maximum time to wait
+                 *  @return number of objects that were popped
+                 */
+                std::size_t waitPop(std::vector<Data> & result,
+                                    std::size_t const limit,
+                            std::chrono::milliseconds const timeout=FOREVER) {
+                    auto append = [&result](Data && data) {
+                        result.push_back(std::move(data));
+                    };
+                    auto ready = [this]() {
+                        return !this->isEmpty() || this->closed.load()
+                            || this->interrupted.load();
+                    };
+                    std::size_t n = this->drain(append, limit);
+                    while (n == 0) {
+                        if (this->closed.load()
+                            || this->interrupted.exchange(false)
+                            || !this->filled.wait(ready, timeout)) {
+                            // closed, interrupted or timed out
+                            return this->drain(append, limit);
+                        }
+                        n = this->drain(append, limit);
+                    }
+                    return n;
+                }
+                /// Wait until the queue is empty
+                /**
+                 *  @param timeout: maximum time to wait
+                 *  @return true if the queue is empty
+                 */
+                bool waitEmpty(std::chrono::milliseconds const timeout=FOREVER) {
+                    return this->drained.wait([this]() {
+                        return this->isEmpty();
+                    }, timeout);
+                }
+                /// Close the queue
+                /**
+                 * This wakes up the waiting consumer. Remaining objects can
+                 *  still be popped.
+                 */
+                inline void close() {
+                    this->closed.store(true);
+                    this->filled.notify();
+                }
+                /// Reopen a closed queue
+                inline void reopen() {
+                    this->closed.store(false);
+                }
+                /// Wake up the waiting consumer without pushing data
+                /**
+                 * The consumer's current or next wait returns without data.
+                 *  Any thread can interrupt the queue, since no slot is used.
+                 */
+                inline void interrupt() {
+                    this->interrupted.store(true);
+                    this->filled.notify();
+                }
+                /// Emptiness check
+                /**
+                 * This is only a snapshot if other threads are working on the
+                 *  queue concurrently.
+                 *  @return true if the queue is empty
+                 */
+                inline bool isEmpty() {
+                    return (this->head.load(std::memory_order_acquire)
+                            == this->tail.load(std::memory_order_acquire));
+                }
+                /// Returns the number of objects inside the queue
+                /**
+                 * This is only a snapshot if other threads are working on the
+                 *  queue concurrently.
+                 *  @return number of objects
+                 */
+                inline std::size_t size() {
+                    auto h = this->head.load(std::memory_order_acquire);
+                    return this->tail.load(std::memory_order_acquire) - h;
+                }
+        };
+
+        /// Lock-free, Bounded Multi-Producer / Single-Consumer Queue
+        /**
+         * This class provides a fifo ring buffer which can be pushed by any
+         *  number of threads and popped by exactly one thread at the same
+         *  time. Each slot carries a sequence number, so producers only need
+         *  a single compare-and-swap to claim a slot. Objects are moved in
+         *  and out of preallocated slots. The queue is bounded: `push` waits
+         *  while the queue is full, use `tryPush` to avoid this.
+         */
+        template <typename Data>
+        class MpscQueue {
+            protected:
+                /// Single slot
+                struct Slot {
+                    /// sequence number of this slot
+                    std::atomic<std::size_t> sequence;
+                    /// stored object
+                    Data data;
+                };
+
+                /// capacity - 1 (capacity is a power of two)
+                std::size_t mask;
+                /// preallocated slots
+                std::unique_ptr<Slot[]> slots;
+                /// padding
+                char pad0[CACHE_LINE];
+                /// next slot to pop (only written by the consumer)
+                std::atomic<std::size_t> head;
+                /// padding
+                char pad1[CACHE_LINE];
+                /// next slot to push (shared by all producers)
+                std::atomic<std::size_t> tail;
+                /// padding
+                char pad2[CACHE_LINE];
+                /// signaled if data was pushed or the queue was closed
+                Signal filled;
+                /// signaled if a consumer found the queue empty
+                Signal drained;
+                /// whether the queue was closed
+                std::atomic<bool> closed;
+                /// whether the next wait returns without data
+                std::atomic<bool> interrupted;
+
+            public:
+                /// Constructor
+                /**
+                 *  @param capacity: minimum number of slots (rounded up to
+                 *      the next power of two)
+                 */
+                MpscQueue(std::size_t const capacity=NET_RING_CAPACITY)
+                    : mask(nextPowerOfTwo(capacity < 2 ? 2 : capacity) - 1)
+                    , slots(new Slot[mask + 1])
+                    , head(0)
+                    , tail(0)
+                    , closed(false)
+                    , interrupted(false) {
+                    for (std::size_t i = 0; i <= this->mask; i++) {
+                        this->slots[i].sequence.store(i,
+                            std::memory_order_relaxed);
+                    }
+                }
+                /// Destructor
+                virtual ~MpscQueue() {
+                }
+                /// Clear all data
+                /**
+                 * This must be called by the consumer.
+                 */
+                inline void clear() {
+                    Data tmp;
+                    while (this->pop(tmp)) {}
+                }
+                /// Try to push data to the queue
+                /**
+                 * This moves the given object to the queue if a slot is free.
+                 *  @param data: object
+                 *  @return false if the queue is full
+                 */
+                template <typename T>
+                inline bool tryPush(T && data) {
+                    auto t = this->tail.load(std::memory_order_relaxed);
+                    Slot * slot;
+                    while (true) {
+                        slot = &this->slots[t & this->mask];
+                        auto seq = slot->sequence.load(
+                            std::memory_order_acquire);
+                        auto diff = std::intptr_t(seq) - std::intptr_t(t);
+                        if (diff == 0) {
+                            // slot is free: try to claim it
+                            if (this->tail.compare_exchange_weak(t, t + 1,
+                                    std::memory_order_relaxed)) {
+                                break;
+                            }
+                        } else if (diff < 0) {
+                            // queue is full
+                            return false;
+                        } else {
+                            // another producer was faster
+                            t = this->tail.load(std::memory_order_relaxed);
+                        }
+                    }
+                    slot->data = std::forward<T>(data);
+                    slot->sequence.store(t + 1, std::memory_order_release);
+                    this->filled.notify();
+                    return true;
+                }
+                /// Push data to the queue
+                /**
+                 * This pushs a given object to the queue. If the queue is full
+                 *  this waits until the consumer popped an object.
+                 *  @param data: object
+                 */
+                inline void push(Data const & data) {
+                    while (!this->tryPush(data)) {
+                        std::this_thread::yield();
+                    }
+                }
+                inline void push(Data && data) {
+                    while (!this->tryPush(std::move(data))) {
+                        std::this_thread::yield();
+                    }
+                }
+                /// Construct an object and push it to the queue
+                /**
+                 * The slots are constructed in advance, so the object is
+                 *  moved into the next free slot.
+                 *  @param args: arguments for the object's constructor
+                 */
+                template <typename... Args>
+                inline void emplace(Args &&... args) {
+                    this->push(Data(std::forward<Args>(args)...));
+                }
+                /// Pop object from queue.
+                /**
+                 * This moves the next object out of the queue.
+                 *  @param result: object to move the data to
+                 *  @return bool describing data was obtained or not
+                 */
+                inline bool pop(Data & result) {
+                    auto h = this->head.load(std::memory_order_relaxed);
+                    auto & slot = this->slots[h & this->mask];
+                    if (slot.sequence.load(std::memory_order_acquire)
+                        != h + 1) {
+                        // slot is not published, yet
+                        this->drained.notify();
+                        return false;
+                    }
+                    result = std::move(slot.data);
+                    // release slot for the next round
+                    slot.sequence.store(h + this->mask + 1,
+                                        std::memory_order_release);
+                    this->head.store(h + 1, std::memory_order_relaxed);
+                    return true;
+                }
+                /// Pop a batch of objects
+                /**
+                 * This moves up to `limit` objects out of the queue and passes
+                 *  each to the given handler (called as `handler(Data &&)`).
+                 *  @param handler: callable to process each object
+                 *  @param limit: maximum number of objects
+                 *  @return number of objects that were popped
+                 */
+                template <typename Handler>
+                std::size_t drain(Handler handler, std::size_t const limit=
+                                  std::numeric_limits<std::size_t>::max()) {
+                    auto h = this->head.load(std::memory_order_relaxed);
+                    std::size_t n = 0;
+                    while (n < limit) {
+                        auto & slot = this->slots[(h + n) & this->mask];
+                        if (slot.sequence.load(std::memory_order_acquire)
+                            != h + n + 1) {
+                            break;
+                        }
+                        handler(std::move(slot.data));
+                        slot.sequence.store(h + n + this->mask + 1,
+                                            std::memory_order_release);
+                        n++;
+                    }
+                    this->head.store(h + n, std::memory_order_relaxed);
+                    if (n == 0) {
+                        this->drained.notify();
+                    }
+                    return n;
+                }
+                /// Wait for an object and pop it
+                /**
+                 * This blocks until an object was pushed, the queue was
+                 *  closed or the timeout expired.
+                 *  @param result: object to move the data to
+                 *  @param timeout: maximum time to wait
+                 *  @return bool describing data was obtained or not
+                 */
+                bool waitPop(Data & result,
+                             std::chrono::milliseconds const timeout=FOREVER) {
+                    auto ready = [this]() {
+                        return !this->isEmpty() || this->closed.load()
+                            || this->interrupted.load();
+                    };
+                    while (!this->pop(result)) {
+                        if (this->closed.load()
+                            || this->interrupted.exchange(false)
+                            || !this->filled.wait(ready, timeout)) {
+                            // closed, interrupted or timed out
+                            return this->pop(result);
+                        }
+                    }
+                    return true;
+                }
+                /// Wait for objects and pop a batch of them
+                /**
+                 * This blocks like `waitPop`, but moves up to `limit` objects
+                 *  to the given vector.
+                 *  @param result: vector to append the objects to
+                 *  @param limit: maximum number of objects
+                 *  @param timeout: maximum time to wait
+                 *  @return number of objects that were popped
+                 */
+                std::size_t waitPop(std::vector<Data> & result,
+                                    std::size_t const limit,
+                            std::chrono::milliseconds const timeout=FOREVER) {
+                    auto append = [&result](Data && data) {
+                        result.push_back(std::move(data));
+                    };
+                    auto ready = [this]() {
+                        return !this->isEmpty() || this->closed.load()
+                            || this->interrupted.load();
+                    };
+                    std::size_t n = this->drain(append, limit);
+                    while (n == 0) {
+                        if (this->closed.load()
+                            || this->interrupted.exchange(false)
+                            || !this->filled.wait(ready, timeout)) {
+                            // closed, interrupted or timed out
+                            return this->drain(append, limit);
+                        }
+                        n = this->drain(append, limit);
+                    }
+                    return n;
+                }
+                /// Wait until the queue is empty
+                /**
+                 *  @param timeout: maximum time to wait
+                 *  @return true if the queue is empty
+                 */
+                bool waitEmpty(std::chrono::milliseconds const timeout=FOREVER) {
+                    return this->drained.wait([this]() {
+                        return this->isEmpty();
+                    }, timeout);
+                }
+                /// Close the queue
+                /**
+                 * This wakes up the waiting consumer. Remaining objects can
+                 *  still be popped.
+                 */
+                inline void close() {
+                    this->closed.store(true);
+                    this->filled.notify();
+                }
+                /// Reopen a closed queue
+                inline void reopen() {
+                    this->closed.store(false);
+                }
+                /// Wake up the waiting consumer without pushing data
+                /**
+                 * The consumer's current or next wait returns without data.
+                 *  Any thread can interrupt the queue, since no slot is used.
+                 */
+                inline void interrupt() {
+                    this->interrupted.store(true);
+                    this->filled.notify();
+                }
+                /// Emptiness check
+                /**
+                 * This is only a snapshot if other threads are working on the
+                 *  queue concurrently.
+                 *  @return true if the queue is empty
+                 */
+                inline bool isEmpty() {
+                    return (this->head.load(std::memory_order_acquire)
+                            == this->tail.load(std::memory_order_acquire));
+                }
+                /// Returns the number of objects inside the queue
+                /**
+                 * This is only a snapshot if other threads are working on the
+                 *  queue concurrently.
+                 *  @return number of objects
+                 */
+                inline std::size_t size() {
+                    auto h = this->head.load(std::memory_order_acquire);
+                    return this->tail.load(std::memory_order_acquire) - h;
+                }
+        };
+
+    }
+
+}
+
+#endif // NET_RINGQUEUE_INCLUDE_GUARD
@@ -0,0 +1,292 @@
+/*
+Copyright (c) 2013 Christian Glöckner <cgloeckner@freenet.de>
+
+This file is part of the networking module:
+    https://github.com/cgloeckner/networking
+
+It offers a tcp-based server-client framework for games and other software.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#ifndef NET_RPC_INCLUDE_GUARD
+#define NET_RPC_INCLUDE_GUARD
+
+#include <set>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <functional>
+#include <unordered_map>
+
+#include <SFML/Network.hpp>
+
+#include <net/common.hpp>
+#include <net/frame.hpp>
+#include <net/profile.hpp>
+
+/// Default time a remote call waits for its response (milliseconds)
+#ifndef NET_CALL_TIMEOUT
+#define NET_CALL_TIMEOUT 5000
+#endif
+
+namespace net {
+
+    namespace utils {
+
+        /// Encode the request or response of a remote call into a frame
+        /**
+         * The frame is flagged by `Frame::CALL` and its data starts with the
+         *  32-bit call ID, followed by the packed object.
+         *  @param object: object to encode
+         *  @param call: ID of the call
+         *  @return frame or an empty pointer if packing failed
+         */
+        template <typename Protocol>
+        FramePtr encodeCall(Protocol & object, CallID const call) {
+            auto frame = std::make_shared<Frame>();
+            frame->body() << sf::Uint32(call);
+            if (!object.pack(frame->body())) {
+                return FramePtr();
+            }
+            frame->seal(Frame::CALL);
+            return frame;
+        }
+
+        /// Take the call ID from the data of a call frame
+        /**
+         *  @param data: received bytes, moved behind the call ID
+         *  @param size: number of bytes, reduced by the call ID's size
+         *  @param call: set to the ID of the call
+         *  @return false if the data is too short
+         */
+        inline bool takeCall(char const * & data, std::size_t & size,
+                             CallID & call) {
+            if (size < 4) {
+                return false;
+            }
+            auto bytes = reinterpret_cast<unsigned char const *>(data);
+            call = (CallID(bytes[0]) << 24) | (CallID(bytes[1]) << 16)
+                 | (CallID(bytes[2]) << 8) | CallID(bytes[3]);
+            data += 4;
+            size -= 4;
+            return true;
+        }
+
+        /// Returns the earlier of two deadlines
+        /**
+         *  @param a: timestamp (see `now`) or 0 for none
+         *  @param b: timestamp (see `now`) or 0 for none
+         *  @return earlier timestamp or 0 if both are none
+         */
+        inline std::uint64_t earliest(std::uint64_t const a,
+                                      std::uint64_t const b) {
+            if (a == 0 || b == 0) {
+                return (a == 0) ? b : a;
+            }
+            return (a < b) ? a : b;
+        }
+
+        /// Returns the time left until a deadline
+        /**
+         *  @param deadline: timestamp (see `now`) or 0 for none
+         *  @return timeout (rounded up) or FOREVER if there is no deadline
+         */
+        inline std::chrono::milliseconds until(std::uint64_t const deadline) {
+            if (deadline == 0) {
+                return FOREVER;
+            }
+            auto time = now();
+            return std::chrono::milliseconds(deadline > time
+                ? (deadline - time + 999999) / 1000000 : 0);
+        }
+
+        /// Remote calls that wait for their responses
+        /**
+         * Each call gets a unique ID and a deadline. It is completed exactly
+         *  once: either with its response, or with NULL if it timed out or
+         *  was cancelled. Completions are invoked without holding the lock,
+         *  so they may start further calls.
+         */
+        template <typename T>
+        class CallTable {
+            public:
+                /// Function receiving the response (or NULL)
+                typedef std::function<void(T *)> Completion;
+
+            protected:
+                /// call that waits for its response
+                struct Call {
+                    /// time the call times out
+                    std::uint64_t deadline;
+                    /// function receiving the response
+                    Completion completion;
+                };
+
+                /// mutex for all calls
+                std::mutex mutex;
+                /// calls keyed by their IDs
+                std::unordered_map<CallID, Call> calls;
+                /// deadlines and IDs of all calls, ordered by their deadlines
+                std::set<std::pair<std::uint64_t, CallID>> deadlines;
+                /// ID of the last call
+                CallID last;
+
+            public:
+                /// Constructor
+                CallTable()
+                    : last(0) {
+                }
+
+                /// Add a call
+                /**
+                 *  @param completion: function receiving the response
+                 *  @param timeout: maximum time to wait for the response
+                 *  @param earliest: set to true if the call times out before
+                 *      all other calls
+                 *  @return ID of the call (never 0)
+                 */
+                CallID add(Completion completion,
+                           std::chrono::milliseconds const timeout,
+                           bool & earliest) {
+                    auto deadline = now() + std::uint64_t(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            timeout).count());
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    do {
+                        this->last++;
+                    } while (this->last == 0
+                             || this->calls.count(this->last) > 0);
+                    Call call;
+                    call.deadline = deadline;
+                    call.completion = std::move(completion);
+                    this->calls.emplace(this->last, std::move(call));
+                    earliest = (this->deadlines.empty()
+                                || deadline < this->deadlines.begin()->first);
+                    this->deadlines.emplace(deadline, this->last);
+                    return this->last;
+                }
+
+                /// Remove a call without completing it
+                /**
+                 *  @param id: ID of the call
+                 */
+                void remove(CallID const id) {
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    auto call = this->calls.find(id);
+                    if (call != this->calls.end()) {
+                        this->deadlines.erase(std::make_pair(
+                            call->second.deadline, id));
+                        this->calls.erase(call);
+                    }
+                }
+
+                /// Complete a call with its response
+                /**
+                 *  @param id: ID of the call
+                 *  @param response: received response
+                 *  @return false if the call is unknown or timed out
+                 */
+                bool complete(CallID const id, T & response) {
+                    Completion completion;
+                    {
+                        std::lock_guard<std::mutex> lock(this->mutex);
+                        auto call = this->calls.find(id);
+                        if (call == this->calls.end()) {
+                            return false;
+                        }
+                        this->deadlines.erase(std::make_pair(
+                            call->second.deadline, id));
+                        completion = std::move(call->second.completion);
+                        this->calls.erase(call);
+                    }
+                    completion(&response);
+                    return true;
+                }
+
+                /// Complete all calls that timed out with NULL
+                /**
+                 *  @param time: current timestamp (see `now`)
+                 *  @return number of calls that timed out
+                 */
+                std::size_t expire(std::uint64_t const time) {
+                    std::vector<Completion> expired;
+                    {
+                        std::lock_guard<std::mutex> lock(this->mutex);
+                        while (!this->deadlines.empty()
+                               && this->deadlines.begin()->first <= time) {
+                            auto call = this->calls.find(
+                                this->deadlines.begin()->second);
+                            expired.push_back(std::move(
+                                call->second.completion));
+                            this->calls.erase(call);
+                            this->deadlines.erase(this->deadlines.begin());
+                        }
+                    }
+                    for (auto c = expired.begin(); c != expired.end(); c++) {
+                        (*c)(NULL);
+                    }
+                    return expired.size();
+                }
+
+                /// Complete all calls with NULL
+                void cancel() {
+                    std::vector<Completion> cancelled;
+                    {
+                        std::lock_guard<std::mutex> lock(this->mutex);
+                        for (auto c = this->calls.begin();
+                             c != this->calls.end(); c++) {
+                            cancelled.push_back(std::move(
+                                c->second.completion));
+                        }
+                        this->calls.clear();
+                        this->deadlines.clear();
+                    }
+                    for (auto c = cancelled.begin(); c != cancelled.end();
+                         c++) {
+                        (*c)(NULL);
+                    }
+                }
+
+                /// Returns the deadline of the call that times out next
+                /**
+                 *  @return timestamp (see `now`) or 0 if no call is waiting
+                 */
+                std::uint64_t next() {
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    return this->deadlines.empty()
+                        ? 0 : this->deadlines.begin()->first;
+                }
+
+                /// Returns the number of waiting calls
+                std::size_t size() {
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    return this->calls.size();
+                }
+        };
+
+    }
+
+}
+
+#endif // NET_RPC_INCLUDE_GUARD
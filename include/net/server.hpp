@@ -30,47 +30,120 @@ SOFTWARE.
 #define NET_SERVER_INCLUDE_GUARD
 
 #include <set>
-#include <map>
+#include <deque>
+#include <chrono>
+#include <memory>
 #include <cstdint>
 
 #include <SFML/Network.hpp>
 
 #include <net/common.hpp>
 #include <net/callbacks.hpp>
+#include <net/poller.hpp>
+#include <net/listener.hpp>
+#include <net/socket.hpp>
+#include <net/frame.hpp>
+#include <net/pool.hpp>
+#include <net/slotmap.hpp>
+#include <net/groups.hpp>
+#include <net/blocklist.hpp>
+#include <net/profile.hpp>
+#include <net/stats.hpp>
+#include <net/session.hpp>
+#include <net/rpc.hpp>
+#include <net/compress.hpp>
+#include <net/coroutine.hpp>
 
 namespace net {
 
     // prototyped for Worker class
-    template <typename Protocol>
+    template <typename Protocol,
+              template <typename> class Queue = utils::SyncQueue>
     class Server;
 
     /// ID for logically grouped clients
     typedef std::uint32_t GroupID;
 
+    /// Policy for workers exceeding their high watermark
+    enum class Overflow {
+        /// Block the pushing thread until the worker reached the low watermark
+        Block,
+        /// Drop the oldest objects that are not being sent, yet (done by the
+        /// worker's network thread, so objects waiting to be written are
+        /// dropped before newer ones)
+        DropOldest,
+        /// Disconnect the worker, because it cannot receive fast enough
+        Disconnect
+    };
+
     /// Worker
     /**
      * This is used in the context of the server class. Each client is handled
-     *  by a worker. This worker contains the client ID, the TCP link and a
-     *  reference to the related server.
+     *  by a worker. This worker contains the client ID, the TCP link, its
+     *  own outgoing queue and a reference to the related server. Because each
+     *  worker is flushed independently, a client that cannot receive data
+     *  fast enough does not delay the other clients.
      */
-    template <typename Protocol>
+    template <typename Protocol,
+              template <typename> class Queue = utils::SyncQueue>
     class Worker {
-        friend class Server<Protocol>;
+        friend class Server<Protocol, Queue>;
 
         protected:
             /// client ID
             ClientID id;
             /// related server
-            Server<Protocol>& server;
+            Server<Protocol, Queue>& server;
             /// TCP link to the client
             sf::TcpSocket link;
+            /// Received bytes that were not handled, yet
+            utils::FrameReader reader;
+            /// Packet reused for unpacking received objects
+            sf::Packet packet;
+            /// Decompression of received frames
+            utils::Inflater inflater;
+            /// Whether the client announced that it inflates frames
+            std::atomic<bool> inflates;
+            /// Outgoing queue of encoded frames
+            utils::SyncQueue<utils::FramePtr> out;
+            /// Frames taken from the queue that were not sent completely, yet
+            std::deque<utils::FramePtr> pending;
+            /// Number of bytes of the first pending frame that were sent
+            std::size_t offset;
+            /// Number of bytes inside the outgoing queue and pending frames
+            std::atomic<std::size_t> queued;
+            /// Whether the worker exceeded its high watermark and is dropped
+            std::atomic<bool> overflowed;
+            /// Whether the worker was scheduled for flushing
+            std::atomic<bool> scheduled;
+            /// Sent and received objects and bytes
+            utils::LinkCounters traffic;
+            /// Whether the worker waits for its link to become writable
+            bool blocked;
+            /// Index of the network thread that owns this worker
+            std::size_t networker;
+            /// Whether the client maintains a session (see <net/session.hpp>)
+            bool resilient;
+            /// Secret token of the session
+            std::uint64_t token;
+            /// Number of objects received within the session
+            std::uint32_t received;
+            /// Number of received objects that were acknowledged
+            std::uint32_t acknowledged;
+            /// Time the link was lost while the session is kept (0 = never)
+            std::atomic<std::uint64_t> detached;
+            /// Value of `detached` once the kept session is taken over
+            static std::uint64_t const CLAIMED = ~std::uint64_t(0);
+            /// Worker whose session was resumed, kept while pushing threads
+            /// might still enqueue at it (used by the network thread only)
+            std::shared_ptr<Worker<Protocol, Queue>> predecessor;
 
             /// Disconnects the worker
             virtual void disconnect();
 
         public:
             /// Constructor
-            Worker(Server<Protocol> & server);
+            Worker(Server<Protocol, Queue> & server);
 
             /// Destructor
             /**
@@ -99,46 +172,272 @@ namespace net {
      * The server handles all clients using Threads. It can handle clients
      *  until a given, fixed maximum or more, if a maximum of -1 is given.
      *  Also it provides banning and unbanning IPs to refuse clients. The
-     *  server contains an incomming queue with received data for all workers
-     *  and an outgoing queue with data ready for sending to a worker.
+     *  server contains an incomming queue with received data for all workers,
+     *  while each worker has an outgoing queue with data ready for sending.
+     *  The queue implementation can be chosen by the second template
+     *  parameter: `utils::SyncQueue` (default, mutex-based) or the lock-free
+     *  `utils::MpscQueue` from <net/ringqueue.hpp>. `utils::SpscQueue` is
+     *  only suitable if a single thread pushes objects to the server.
+     *  Incomming objects are handled by one thread by default. More handler
+     *  threads can be used (see `setHandlers`); all objects with the same
+     *  shard key (see `shard`) are handled by the same thread, so their order
+     *  is preserved. In this case the callbacks need to be thread-safe.
+     *  Sending and receiving is done by one network thread by default. More
+     *  network threads can be used (see `setNetworkers`); each accepted
+     *  client is assigned to the network thread with the fewest clients,
+     *  which then does all sending and receiving for it.
+     *  Clients are accepted by one thread by default. On Linux, several
+     *  listeners can share the port (see `setAcceptors`), each accepting
+     *  clients in its own thread.
+     *  If coroutines are supported (see <net/coroutine.hpp>), objects,
+     *  drained workers and timers can also be awaited (see `receive`, `send`
+     *  and `sleep`).
      */
-    template <typename Protocol>
+    template <typename Protocol, template <typename> class Queue>
     class Server: public CallbackManager<CommandID, Protocol &> {
-        friend class Worker<Protocol>;
+        friend class Worker<Protocol, Queue>;
 
         protected:
-            /// Listener for accepting clients
-            sf::TcpListener listener;
+            /// Listener with its own accept thread
+            struct Acceptor {
+                /// Listener for accepting clients
+                sf::TcpListener listener;
+                /// Thread accepting clients from the listener
+                std::thread thread;
+                /// Worker for the next client (allocated after an accept)
+                std::unique_ptr<Worker<Protocol, Queue>> spare;
+#ifdef NET_USE_EPOLL
+                /// Readiness notification for the listener
+                utils::Poller poller;
+#endif
+            };
+            /// Acceptors (sharing the port if more than one)
+            std::vector<std::unique_ptr<Acceptor>> acceptors;
             /// Threads
-            std::thread accepter;
-            std::thread networker;
-            std::thread handler;
+            std::vector<std::thread> handlers;
             /// Maximum number of clients (-1 = infinite)
             std::int16_t max_clients;
-            /// Next worker's ID
-            ClientID next_id;
             /// Structure of all workers keyed by their IDs
-            std::map<ClientID, Worker<Protocol>*> workers;
-            /// Set of blocked IPs
-            std::set<std::string> ips;
+            utils::SlotMap<Worker<Protocol, Queue>> workers;
+            /// Blocked IPs and ranges
+            utils::Blocklist ips;
             /// Logically grouped clients
-            std::map<GroupID, std::set<ClientID>> groups;
+            utils::GroupIndex<GroupID, ClientID> groups;
             /// Serveral mutex stuff
-            std::mutex workers_mutex;
-            std::mutex ips_mutex;
             std::mutex groups_mutex;
-            /// Queues
-            utils::SyncQueue<Protocol> in;
-            utils::SyncQueue<Protocol> out;
+            /// Recycled objects for received data
+            utils::ObjectPool<Protocol> pool;
+            /// Latencies of the message pipeline (see NET_PROFILE)
+            utils::Profile profile;
+            /// Incomming queues (one per handler thread)
+            std::vector<std::unique_ptr<Queue<utils::Pooled<Protocol>>>> in;
+            /// Network thread with its own subset of workers
+            struct Networker {
+                /// Thread doing all sending and receiving of its workers
+                std::thread thread;
+                /// IDs of its workers that have outgoing data
+                Queue<ClientID> ready;
+                /// IDs of its workers scheduled by network threads (e.g. for
+                /// control frames), so `ready` keeps the pushing threads as
+                /// its only producers
+                utils::SyncQueue<ClientID> requeued;
+                /// Number of its workers
+                std::atomic<std::size_t> load;
+#ifdef NET_USE_EPOLL
+                /// Readiness notification for its workers
+                utils::Poller poller;
+#endif
+
+                /// Traffic of its workers (including disconnected ones)
+                utils::LinkCounters traffic;
+                /// IDs of its workers whose sessions are kept after their
+                /// links were lost (used by the network thread only)
+                std::vector<ClientID> detached;
+
+                Networker(): load(0) {}
+            };
+            /// Network threads
+            std::vector<std::unique_ptr<Networker>> networkers;
+            /// Number of objects inside the workers' outgoing queues
+            std::atomic<std::size_t> backlog;
+            /// Signaled when the backlog was sent completely
+            utils::Signal sent;
+            /// Maximum number of frames written by a single send
+            std::size_t batch_size;
+            /// Time between flushing scheduled workers (0 = immediately)
+            std::chrono::milliseconds flush_interval;
+            /// Whether Nagle's algorithm is disabled for the workers' links
+            bool nodelay;
+            /// Whether the workers' links are corked while flushing
+            bool cork;
+            /// Number of queued bytes a worker is resumed at (Block policy)
+            std::size_t low_watermark;
+            /// Number of queued bytes the overflow policy applies at (0 = off)
+            std::size_t high_watermark;
+            /// Overflow policy
+            Overflow overflow;
+            /// Time a session is kept after its link was lost (0 = off)
+            std::chrono::milliseconds session_timeout;
+            /// Compression of outgoing frames
+            utils::Compression compression;
+            /// Number of workers that reached their low watermark or left
+            std::atomic<std::size_t> drains;
+            /// Signaled when a worker reached its low watermark or left
+            utils::Signal drained;
+            /// Callback execution times (one per handler thread)
+            std::vector<std::unique_ptr<utils::CommandTimer>> timers;
+            /// Number of accepted, refused and disconnected clients
+            std::atomic<std::uint64_t> accepted;
+            std::atomic<std::uint64_t> refused;
+            std::atomic<std::uint64_t> disconnected;
+            /// Number of resumed sessions
+            std::atomic<std::uint64_t> resumed;
+            /// Number of outgoing objects that were dropped
+            std::atomic<std::uint64_t> dropped;
+            /// Whether the incomming queues were closed
+            std::atomic<bool> closed;
+#ifdef NET_USE_COROUTINES
+            /// Coroutines waiting for objects (keyed by client and command)
+            /// or a time
+            utils::Scheduler<Protocol> receivers;
+            /// Coroutines waiting for workers to drain (keyed by client)
+            utils::Scheduler<Protocol> senders;
+
+            /// Wake up the first handler thread, which resumes coroutines
+            inline void resumeLater() {
+                this->in[0]->interrupt();
+            }
+            /// Returns the key of a client's objects with a command
+            static inline std::uint64_t awaited(ClientID const client,
+                                                CommandID const command) {
+                return (std::uint64_t(client) << 32) | command;
+            }
+            /// Returns an awaiter that is resumed by the first handler thread
+            utils::Awaiter<Protocol> await(
+                std::chrono::milliseconds const timeout);
+#endif
+            /// Wake up a network thread
+            inline void wakeup(std::size_t const index) {
+#ifdef NET_USE_EPOLL
+                this->networkers[index]->poller.wakeup();
+#endif
+            }
 
-            /// Send / Receive next Data
-            bool sendNext();
-            bool receiveNext(ClientID const clientid, sf::TcpSocket & link);
+            /// Enqueue a frame at the worker
+            /**
+             * The overflow policy is applied if the worker exceeds its high
+             *  watermark, except for blocking (see `throttle`).
+             *  @return true if the worker needs to be scheduled
+             */
+            bool enqueue(Worker<Protocol, Queue> & worker,
+                         utils::FramePtr const & frame);
+            /// Returns the frame to send to the worker
+            /**
+             * Frames are only compressed for clients that announced to
+             *  inflate them. The frame is compressed once for all of them.
+             *  @param worker: receiving worker
+             *  @param frame: uncompressed frame
+             *  @param compressed: compressed frame (set on first use)
+             *  @return either frame
+             */
+            utils::FramePtr const & outgoing(Worker<Protocol, Queue> & worker,
+                                             utils::FramePtr const & frame,
+                                             utils::FramePtr & compressed);
+            /// Enqueue a frame at all given workers
+            /**
+             * @param missing: collects IDs without a worker instead of
+             *  reporting them (e.g. group members that just disconnected)
+             */
+            template <typename Iterator>
+            void deliver(utils::FramePtr const & frame, Iterator begin,
+                         Iterator end, std::vector<ClientID> * missing = NULL);
+            /// Schedule workers (ID and networker index) for flushing
+            void schedule(std::vector<std::pair<ClientID, std::size_t>> const
+                          & scheduled);
+            /// Returns whether a pushing thread has to wait for the worker
+            inline bool isFull(Worker<Protocol, Queue> const & worker) const {
+                return (this->high_watermark > 0
+                        && this->overflow == Overflow::Block
+                        && worker.queued > this->high_watermark);
+            }
+            /// Wait until the given workers reached their low watermark
+            void throttle(std::vector<ClientID> const & full);
+            /// Mark bytes of a worker as sent or dropped
+            void unqueue(Worker<Protocol, Queue> & worker,
+                         std::size_t const bytes);
+            /// Returns the bytes a frame counts toward the watermarks
+            /**
+             * Control frames are not subject to the overflow policy, so they
+             *  do not count.
+             */
+            static inline std::size_t counted(utils::FramePtr const & frame) {
+                return (frame->flags() & utils::Frame::CONTROL)
+                    ? 0 : frame->size();
+            }
+            /// Drop the oldest frames until the high watermark is reached
+            void trim(Worker<Protocol, Queue> & worker);
+            /// Take the frames that were enqueued at the worker's predecessor
+            /**
+             * The predecessor is released once no other thread refers to it,
+             *  so no frame pushed during a resume is lost.
+             */
+            void adopt(Worker<Protocol, Queue> & worker);
+            /// Drop all outgoing objects of a worker
+            void discard(Worker<Protocol, Queue> & worker);
+            /// Mark objects as sent or dropped
+            void release(std::size_t const count);
+            /// Send a control message before all queued objects
+            void control(Worker<Protocol, Queue> & worker,
+                         utils::Control const & message);
+
+            /// Accept next client of an acceptor
+            bool acceptNext(Acceptor & acceptor);
+            /// Flush next scheduled worker of a network thread
+            bool sendNext(Networker & networker);
+            /// Send as many frames of the worker as possible
+            bool flush(Worker<Protocol, Queue> & worker);
+            /// Receive next Data
+            bool receiveNext(Worker<Protocol, Queue> & worker);
+            /// Handle a control message received from a worker
+            void receiveControl(Worker<Protocol, Queue> & worker,
+                                char const * data, std::size_t size);
+            /// Take ownership of a kept session
+            /**
+             * Only one thread can claim a session, so it is either resumed
+             *  or expired. The worker stays detached afterwards.
+             *  @param worker: worker keeping the session
+             *  @param age: minimum time (in nanoseconds) since the link was
+             *      lost
+             *  @return true if the session was claimed by the caller
+             */
+            bool claim(Worker<Protocol, Queue> & worker,
+                       std::uint64_t const age=0);
+            /// Take over the kept session of a previous (claimed) worker
+            void resume(Worker<Protocol, Queue> & worker,
+                        Worker<Protocol, Queue> & previous,
+                        std::uint32_t const sequence);
+            /// Handle a broken link of a worker
+            void lost(Worker<Protocol, Queue> & worker);
+            /// Disconnect workers whose sessions were kept too long
+            void expire(Networker & networker);
+
+            /// Returns the shard key of an incomming object
+            /**
+             * Objects with the same shard key are handled by the same handler
+             *  thread in the order they were received. By default, objects
+             *  are sharded by their source client. Override this to keep
+             *  e.g. all clients of a game session on the same thread.
+             *  @param object: received object
+             *  @return shard key
+             */
+            virtual std::size_t shard(Protocol const & object) {
+                return object.client;
+            }
 
             /// Threaded Loops
-            void accept_loop();
-            void network_loop();
-            void handle_loop();
+            void accept_loop(std::size_t const index);
+            void network_loop(std::size_t const index);
+            void handle_loop(std::size_t const index);
 
         public:
             /// Constructor
@@ -157,18 +456,173 @@ namespace net {
             /// Start the server to listen on a given port
             /**
              * Triggers the server to start listening on a given local port.
-             *  It will start the accepter-loop as a Thread.
+             *  It will start the accepter-loops as Threads.
              *  @param port: local port number
              */
             bool start(std::uint16_t const port);
 
+            /// Set the number of handler threads
+            /**
+             * Incomming objects are distributed to the given number of handler
+             *  threads by their shard key. This must be called before the
+             *  server is started.
+             *  @param number: number of handler threads (at least 1)
+             *  @return false if the server is online or the number is invalid
+             */
+            bool setHandlers(std::size_t const number);
+
+            /// Set the number of network threads
+            /**
+             * Clients are distributed to the given number of network threads
+             *  when they are accepted. This must be called before the server
+             *  is started.
+             *  @param number: number of network threads (at least 1)
+             *  @return false if the server is online or the number is invalid
+             */
+            bool setNetworkers(std::size_t const number);
+
+            /// Set the number of acceptors
+            /**
+             * Each acceptor opens its own listener on the server's port and
+             *  accepts clients in its own thread. The kernel distributes new
+             *  clients among them. More than one acceptor is only supported
+             *  with SO_REUSEPORT (see <net/listener.hpp>). This must be called
+             *  before the server is started.
+             *  @param number: number of acceptors (at least 1)
+             *  @return false if the server is online or the number is invalid
+             */
+            bool setAcceptors(std::size_t const number);
+
+            /// Set the maximum number of frames written at once
+            /**
+             * All frames that are queued for a worker are written by a single
+             *  gather-write (see <net/socket.hpp>), up to the given number.
+             *  This must be called before the server is started.
+             *  @param size: maximum number of frames (at least 1)
+             *  @return false if the server is online or the size is invalid
+             */
+            bool setBatchSize(std::size_t const size);
+
+            /// Set the interval of flushing the workers
+            /**
+             * By default, workers are flushed as soon as objects were pushed.
+             *  With an interval, the network threads flush all scheduled
+             *  workers once per interval, so bursts of objects are written by
+             *  fewer sends. This only applies to the epoll reactor. This must
+             *  be called before the server is started.
+             *  @param interval: time between two flushes (0 = immediately)
+             *  @return false if the server is online
+             */
+            bool setFlushInterval(std::chrono::milliseconds const interval);
+
+            /// Set TCP_NODELAY and TCP_CORK for the workers' links
+            /**
+             * By default, Nagle's algorithm is disabled (like SFML does) and
+             *  the links are not corked. If corking is enabled, a worker's
+             *  link is corked while flushing it and uncorked afterwards. This
+             *  must be called before the server is started.
+             *  @param nodelay: whether to disable Nagle's algorithm
+             *  @param cork: whether to cork the links while flushing
+             *  @return false if the server is online
+             */
+            bool setTcpOptions(bool const nodelay, bool const cork);
+
+            /// Set the watermarks of the workers' outgoing data
+            /**
+             * If more than `high` bytes are queued for a worker, the given
+             *  policy is applied: pushing threads are blocked until at most
+             *  `low` bytes are left, the oldest objects that are not being
+             *  sent are dropped, or the worker is disconnected. By default,
+             *  the outgoing data is unlimited. This must be called before
+             *  the server is started.
+             *  @param low: number of bytes to resume blocked threads at
+             *  @param high: number of bytes to apply the policy at (0 = off)
+             *  @param policy: overflow policy
+             *  @return false if the server is online or low exceeds high
+             */
+            bool setWatermarks(std::size_t const low, std::size_t const high,
+                               Overflow const policy=Overflow::Block);
+
+            /// Set the time sessions are kept after their links were lost
+            /**
+             * Resilient clients (see `Client::setReconnect`) maintain a
+             *  session. If such a client's link is lost, its worker is kept
+             *  for the given time: it keeps its ID and groups, and objects
+             *  pushed to it are queued. If the client reconnects in time, it
+             *  resumes the session and receives the queued objects. Objects
+             *  that were written to the lost link might be lost, too. By
+             *  default, sessions are not kept. This must be called before
+             *  the server is started.
+             *  @param timeout: time to keep lost sessions (0 = off)
+             *  @return false if the server is online
+             */
+            bool setSessionTimeout(std::chrono::milliseconds const timeout);
+
+            /// Compress large outgoing objects
+            /**
+             * Objects whose packed data has at least `threshold` bytes are
+             *  deflated once when they are pushed (see <net/compress.hpp>),
+             *  if this makes them smaller. Clients decompress them before
+             *  unpacking, so the protocol is not affected. Objects are only
+             *  compressed for clients that announced to inflate them (see
+             *  `utils::Control::Compress`). Compression needs
+             *  NET_USE_ZLIB to be defined. This must be called before the
+             *  server is started.
+             *  @param threshold: minimum size to compress (0 = off)
+             *  @param level: zlib compression level (-1 = zlib's default)
+             *  @return false if the server is online or compression is not
+             *      available
+             */
+            bool setCompression(std::size_t const threshold, int const level=-1);
+
+            /// Set the number of recycled objects
+            /**
+             * Received objects are taken from a pool and returned to it after
+             *  they were handled, so their strings and vectors keep their
+             *  capacity. Recycled objects are reset by `clear` before they
+             *  are reused, so only enable this if the protocol overrides
+             *  `clear` to reset all of its members. By default, objects are
+             *  not recycled (see NET_POOL_CAPACITY).
+             *  @param size: maximum number of spare objects (0 = off)
+             */
+            inline void setPoolSize(std::size_t const size) {
+                this->pool.setCapacity(size);
+            }
+
+            /// Returns the latency histogram of a pipeline stage
+            /**
+             * Latencies are only measured if NET_PROFILE is defined,
+             *  otherwise the histograms stay empty. All values are given in
+             *  nanoseconds.
+             *  @param stage: stage of the message pipeline
+             *  @return histogram of the stage
+             */
+            inline utils::Histogram const & getLatency(Stage const stage) const {
+                return this->profile[stage];
+            }
+
+            /// Remove all measured latencies
+            inline void resetLatency() {
+                this->profile.reset();
+            }
+
+            /// Returns a snapshot of the server's statistics
+            /**
+             * The counters are maintained by the threads that are involved
+             *  anyway and are only summed up here, so the snapshot is cheap
+             *  to maintain but not taken atomically. Write it to a stream to
+             *  obtain a text dump.
+             *  @return statistics
+             */
+            ServerStats getStats();
+
             /// Returns whether the server is online
             /**
              * Returns whether the server is online (= is listening) or not
              *  @return true if online
              */
             inline bool isOnline() {
-                return (this->listener.getLocalPort() != 0);
+                return (this->acceptors[0]->listener.getLocalPort() != 0);
             }
 
             /// Shutdown the server safely
@@ -181,7 +635,7 @@ namespace net {
             /// Shutdown the server
             /**
              * This will stop listening on a local port and shutdown the
-             *  accepter-loop Thread safely. It also will disconnect all
+             *  accepter-loop Threads safely. It also will disconnect all
              *  workers, stop their Threads and delete them from the server
              */
             void disconnect();
@@ -196,27 +650,53 @@ namespace net {
 
             /// Block an IP-address
             /**
-             * This will add the given IP-address to the blocking list
-             *  @param ip: IP-address or hostname
+             * This will add the given IP-address to the blocking list. CIDR
+             *  ranges like "10.0.0.0/8" or "2001:db8::/32" block all
+             *  addresses inside the range. Hostnames are resolved once.
+             *  @param ip: IP-address, range or hostname
+             *  @return false if the address is not valid
+             */
+            inline bool block(std::string const & ip) {
+                return (this->ips.insert(&ip, &ip + 1) == 1);
+            }
+
+            /// Block multiple IP-addresses
+            /**
+             * This rebuilds the blocking list only once, so it should be used
+             *  for loading large lists.
+             *  @param list: IP-addresses, ranges or hostnames
+             *  @return number of valid addresses
              */
-            inline void block(std::string const & ip) {
-                this->ips_mutex.lock();
-                this->ips.insert(ip);
-                this->ips_mutex.unlock();
+            inline std::size_t block(std::vector<std::string> const & list) {
+                return this->ips.insert(list.begin(), list.end());
             }
 
             /// Unblock an IP-address
             /**
-             * This will remove the given IP-address from the blocking list
-             *  @param ip: IP-address or hostname
+             * This will remove the given IP-address (or range) from the
+             *  blocking list. It must match an address or range that was
+             *  blocked before.
+             *  @param ip: IP-address, range or hostname
              */
             inline void unblock(const std::string& ip) {
-                this->ips_mutex.lock();
-                auto node = this->ips.find(ip);
-                if (node != this->ips.end()) {
-                    this->ips.erase(node);
-                }
-                this->ips_mutex.unlock();
+                this->ips.erase(&ip, &ip + 1);
+            }
+
+            /// Unblock multiple IP-addresses
+            /**
+             *  @param list: IP-addresses, ranges or hostnames
+             */
+            inline void unblock(std::vector<std::string> const & list) {
+                this->ips.erase(list.begin(), list.end());
+            }
+
+            /// Returns whether an IP-address is blocked
+            /**
+             *  @param ip: IP-address
+             *  @return true if blocked
+             */
+            inline bool isBlocked(sf::IpAddress const & ip) const {
+                return this->ips.contains(ip);
             }
 
             /// Push an object to a worker
@@ -227,12 +707,79 @@ namespace net {
              *  @param object: an object to send
              *  @param id: destination's client ID
              */
-            inline void push(Protocol & object, ClientID const id) {
-                // Set target client
-                object.client = id;
-                // Push to outgoing queue
-                this->out.push(object);
+            void push(Protocol & object, ClientID const id);
+            /// Push a temporary object to a worker
+            /**
+             * The object is packed directly, so it is never copied.
+             */
+            inline void push(Protocol && object, ClientID const id) {
+                this->push(object, id);
+            }
+
+            /// Answer a remote call
+            /**
+             * The response is pushed to the calling client, which passes it
+             *  to the completion of its call instead of the attached
+             *  callbacks. If the request is no call, the response is pushed
+             *  like any other object.
+             *  @param request: received object of the call
+             *  @param response: object to answer with
+             */
+            void reply(Protocol const & request, Protocol & response);
+            /// Answer a remote call with a temporary object
+            inline void reply(Protocol const & request, Protocol && response) {
+                this->reply(request, response);
+            }
+
+#ifdef NET_USE_COROUTINES
+            /// Wait for the next object of a client with a command
+            /**
+             * The awaiting coroutine is resumed with a copy of the object by
+             *  the handler thread of the object's shard, which does not
+             *  trigger the attached callbacks then. If several coroutines
+             *  wait for the same client and command, they receive the
+             *  objects in order.
+             *  @param client: client to wait for
+             *  @param command: command to wait for
+             *  @param timeout: maximum time to wait
+             *  @return awaitable yielding the object, or an empty optional if
+             *      it timed out, the client left or the server stopped
+             */
+            utils::Awaiter<Protocol> receive(ClientID const client,
+                CommandID const command,
+                std::chrono::milliseconds const timeout=utils::FOREVER);
+
+            /// Push an object to a worker without blocking
+            /**
+             * This works like `push`, but if the worker exceeds its high
+             *  watermark (see `setWatermarks` with `Overflow::Block`), the
+             *  awaiting coroutine is suspended instead of the thread. It is
+             *  resumed by the first handler thread as soon as the worker
+             *  reached its low watermark or left.
+             *  @param object: an object to send
+             *  @param id: destination's client ID
+             *  @return awaitable yielding an empty optional
+             */
+            utils::Awaiter<Protocol> send(Protocol & object,
+                                          ClientID const id);
+            /// Push a temporary object to a worker without blocking
+            inline utils::Awaiter<Protocol> send(Protocol && object,
+                                                 ClientID const id) {
+                return this->send(object, id);
+            }
+
+            /// Wait for some time
+            /**
+             * The awaiting coroutine is resumed by the first handler thread,
+             *  so no thread is blocked meanwhile.
+             *  @param duration: time to wait
+             *  @return awaitable yielding an empty optional
+             */
+            inline utils::Awaiter<Protocol> sleep(
+                std::chrono::milliseconds const duration) {
+                return this->await(duration);
             }
+#endif
 
             /// Push an object to all workers
             /**
@@ -242,6 +789,10 @@ namespace net {
              *  @param object: object to send
              */
             void push(Protocol & object);
+            /// Push a temporary object to all workers
+            inline void push(Protocol && object) {
+                this->push(object);
+            }
 
             /// Push an object to some workers
             /**
@@ -255,6 +806,10 @@ namespace net {
              *  @param group: group id to use for client notification
              */
             void pushGroup(Protocol & object, GroupID const group);
+            /// Push a temporary object to some workers
+            inline void pushGroup(Protocol && object, GroupID const group) {
+                this->pushGroup(object, group);
+            }
 
             /// Add a client to a group
             /**
@@ -265,6 +820,16 @@ namespace net {
              */
             void group(ClientID const client, GroupID const group);
 
+            /// Add multiple clients to a group
+            /**
+             * Works like adding each client on its own, but the group's
+             *  members are rebuilt only once.
+             * @param clients: ids of the clients
+             * @param group: id of the group
+             */
+            void group(std::vector<ClientID> const & clients,
+                       GroupID const group);
+
             /// Remove a client from a group
             /**
              * Will remove a client from a group. If the client is not in the
@@ -275,6 +840,16 @@ namespace net {
              */
             void ungroup(ClientID const client, GroupID const group);
 
+            /// Remove multiple clients from a group
+            /**
+             * Works like removing each client on its own, but the group's
+             *  members are rebuilt only once.
+             * @param clients: ids of the clients
+             * @param group: id of the group
+             */
+            void ungroup(std::vector<ClientID> const & clients,
+                         GroupID const group);
+
             /// Return all clients in this group
             /**
              * Will return a set of clients from this group. If the given group
@@ -293,373 +868,1434 @@ namespace net {
 
     };
 
-    template <typename Protocol>
-    Worker<Protocol>::Worker(Server<Protocol> & server)
-        : server(server) {
+    template <typename Protocol, template <typename> class Queue>
+    Worker<Protocol, Queue>::Worker(Server<Protocol, Queue> & server)
+        : server(server)
+        , inflates(false)
+        , offset(0)
+        , queued(0)
+        , overflowed(false)
+        , scheduled(false)
+        , blocked(false)
+        , networker(0)
+        , resilient(false)
+        , token(0)
+        , received(0)
+        , acknowledged(0)
+        , detached(0) {
     }
 
-    template <typename Protocol>
-    Worker<Protocol>::~Worker() {
+    template <typename Protocol, template <typename> class Queue>
+    Worker<Protocol, Queue>::~Worker() {
         this->link.disconnect();
+        this->server.discard(*this);
     }
 
-    template <typename Protocol>
-    void Worker<Protocol>::disconnect() {
+    template <typename Protocol, template <typename> class Queue>
+    void Worker<Protocol, Queue>::disconnect() {
         this->server.disconnect(this->id);
     }
 
     // ------------------------------------------------------------------------
 
-    template <typename Protocol>
-    Server<Protocol>::Server(std::int16_t const max_clients)
+    template <typename Protocol, template <typename> class Queue>
+    Server<Protocol, Queue>::Server(std::int16_t const max_clients)
         : CallbackManager<CommandID, Protocol &>()
         , max_clients(max_clients)
-        , next_id(0) {
+        , backlog(0)
+        , batch_size(64)
+        , flush_interval(0)
+        , nodelay(true)
+        , cork(false)
+        , low_watermark(0)
+        , high_watermark(0)
+        , overflow(Overflow::Block)
+        , session_timeout(0)
+        , drains(0)
+        , accepted(0)
+        , refused(0)
+        , disconnected(0)
+        , resumed(0)
+        , dropped(0)
+        , closed(false) {
         // Workaround for Tcp Socket Crash
         utils::SocketCrashWorkaround();
+        this->setAcceptors(1);
+        this->setHandlers(1);
+        this->setNetworkers(1);
     }
 
-    template <typename Protocol>
-    Server<Protocol>::~Server() {
+    template <typename Protocol, template <typename> class Queue>
+    Server<Protocol, Queue>::~Server() {
         if (this->isOnline()) {
             this->disconnect();
         }
+        // Spare workers refer to this server
+        this->acceptors.clear();
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    bool Server<Protocol, Queue>::acceptNext(Acceptor & acceptor) {
+        // Check for next Client
+        if (acceptor.spare == NULL) {
+            acceptor.spare.reset(new Worker<Protocol, Queue>(*this));
+        }
+        auto status = acceptor.listener.accept(acceptor.spare->link);
+        if (status != sf::Socket::Done) {
+            // Nothing happened, keep the worker for the next client
+            return false;
+        }
+        std::shared_ptr<Worker<Protocol, Queue>> next(acceptor.spare.release());
+        next->link.setBlocking(false);
+        if (!this->nodelay) {
+            utils::setNoDelay(next->link, false);
+        }
+
+        // Check if blocked
+        auto address = next->link.getRemoteAddress();
+        if (this->ips.contains(address)) {
+            // This host is banned
+            next->link.disconnect();
+            this->refused++;
+            return true;
+        }
+
+        // Check number of clients
+        auto number = this->workers.size();
+        std::string hostname = address.toString();
+        std::uint16_t port = next->link.getRemotePort();
+        if (this->max_clients != -1 && number >= this->max_clients) {
+            // Server is full
+            next->link.disconnect();
+            this->refused++;
+            std::cerr << "New client from " << hostname << ":" << port
+                      << " was refused, because the maximum limit of"
+                      << " clients has been reached" << std::endl
+                      << std::flush;
+            return true;
+        }
+
+        // Assign ClientID
+        ClientID id = this->workers.reserve();
+        if (id == utils::SlotMap<Worker<Protocol, Queue>>::INVALID) {
+            next->link.disconnect();
+            this->refused++;
+            std::cerr << "New client from " << hostname << ":" << port
+                      << " was refused, because no client ID is left"
+                      << std::endl << std::flush;
+            return true;
+        }
+        sf::Packet packet;
+        // Announce whether compressed frames are accepted
+        packet << id << sf::Uint8(utils::Compression::isAvailable() ? 1 : 0);
+        status = next->link.send(packet);
+        if (status == sf::Socket::Done) {
+            // Assign to the network thread with the fewest workers
+            std::size_t index = 0;
+            for (std::size_t i = 1; i < this->networkers.size(); i++) {
+                if (this->networkers[i]->load
+                    < this->networkers[index]->load) {
+                    index = i;
+                }
+            }
+            // Add to Server
+            next->id = id;
+            next->networker = index;
+            this->networkers[index]->load++;
+#ifdef NET_USE_EPOLL
+            this->networkers[index]->poller.add(utils::getHandle(next->link),
+                                                id);
+#endif
+            this->workers.insert(id, next);
+            this->accepted++;
+            std::cerr << "Client #" << id << " accepted from " << hostname
+                      << ":" << port << std::endl << std::flush;
+        } else {
+            // Release the client ID
+            this->workers.erase(id);
+            next->link.disconnect();
+            this->refused++;
+        }
+        return true;
     }
 
-    template <typename Protocol>
-    void Server<Protocol>::accept_loop() {
-        while (this->isOnline()) { 
-            // Check for next Client
-            auto next = new Worker<Protocol>(*this);
-            auto status = this->listener.accept(next->link);
-            if (status != sf::Socket::Done) {
+    template <typename Protocol, template <typename> class Queue>
+    void Server<Protocol, Queue>::accept_loop(std::size_t const index) {
+        auto & acceptor = *this->acceptors[index];
+#ifdef NET_USE_EPOLL
+        std::vector<utils::Poller::Event> events;
+        while (this->isOnline()) {
+            // Accept all pending clients
+            while (this->acceptNext(acceptor)) {}
+            // Wait for further clients
+            acceptor.poller.wait(events);
+        }
+#else
+        while (this->isOnline()) {
+            if (!this->acceptNext(acceptor)) {
                 // Nothing happened
                 utils::delay(25);
-                delete next;
-                continue;
             }
-            next->link.setBlocking(false);
-            
-            // Check number of clients
-            this->workers_mutex.lock();
-            auto number = this->workers.size();
-            this->workers_mutex.unlock();
-            std::string hostname = next->link.getRemoteAddress().toString();
-            std::uint16_t port = next->link.getRemotePort();
-            if (this->max_clients != -1 && number >= this->max_clients) {
-                // Server is full
-                next->link.disconnect();
-                delete next;
-                std::cerr << "New client from " << hostname << ":" << port
-                          << " was refused, because the maximum limit of"
-                          << " clients has been reached" << std::endl
-                          << std::flush;
-                utils::delay(50);
+        }
+#endif
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    bool Server<Protocol, Queue>::enqueue(Worker<Protocol, Queue> & worker,
+                                          utils::FramePtr const & frame) {
+        if (worker.overflowed) {
+            // Worker is about to be disconnected
+            return false;
+        }
+        this->backlog++;
+        worker.queued += frame->size();
+        worker.out.push(frame);
+        if (this->high_watermark > 0
+            && worker.queued > this->high_watermark) {
+            switch (this->overflow) {
+                case Overflow::DropOldest:
+                    // Oldest frames are dropped by its network thread (see
+                    // trim), which owns the frames waiting to be written
+                    break;
+                case Overflow::Disconnect:
+                    // Disconnected by its network thread
+                    worker.overflowed = true;
+                    break;
+                case Overflow::Block:
+                    // Pushing thread waits after enqueuing (see throttle)
+                    break;
+            }
+        }
+        return !worker.scheduled.exchange(true);
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    utils::FramePtr const & Server<Protocol, Queue>::outgoing(
+        Worker<Protocol, Queue> & worker, utils::FramePtr const & frame,
+        utils::FramePtr & compressed) {
+        if (!worker.inflates) {
+            return frame;
+        }
+        if (compressed == NULL) {
+            compressed = this->compression.apply(frame);
+        }
+        return compressed;
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    template <typename Iterator>
+    void Server<Protocol, Queue>::deliver(utils::FramePtr const & frame,
+                                          Iterator begin, Iterator end,
+                                          std::vector<ClientID> * missing) {
+        std::vector<std::pair<ClientID, std::size_t>> scheduled;
+        std::vector<ClientID> full;
+        utils::FramePtr compressed;
+        for (auto id = begin; id != end; id++) {
+            auto worker = this->workers.find(*id);
+            if (worker == NULL && missing != NULL) {
+                missing->push_back(*id);
                 continue;
             }
-            
-            // Check if blocked
-            this->ips_mutex.lock();
-            bool blocked = (this->ips.find(hostname) != this->ips.end());
-            this->ips_mutex.unlock();
-            if (blocked) {
-                // This host is banned
-                next->link.disconnect();
-                delete next;
-                std::cerr << "Client from banned host " << hostname << ":"
-                          << port << " was refused" << std::endl << std::flush;
+            if (worker == NULL) {
+                std::cerr << "Worker #" << *id << " was not found"
+                          << std::endl << std::flush;
                 continue;
             }
+            if (this->enqueue(*worker,
+                              this->outgoing(*worker, frame, compressed))) {
+                scheduled.emplace_back(*id, worker->networker);
+            }
+            if (this->isFull(*worker)) {
+                full.push_back(*id);
+            }
+        }
+        this->schedule(scheduled);
+        this->throttle(full);
+    }
 
-            // Assign ClientID
-            this->workers_mutex.lock();
-            ClientID id = this->next_id;
-            sf::Packet packet;
-            packet << id;
-            status = next->link.send(packet);
-            if (status == sf::Socket::Done) {
-                // Add to Server
-                next->id = id;
-                this->workers[id] = next;
-                this->next_id++;
-                std::cerr << "Client #" << id << " accepted from " << hostname
-                          << ":" << port << std::endl << std::flush;
-            } else {
-                next->link.disconnect();
-                delete next;
+    template <typename Protocol, template <typename> class Queue>
+    void Server<Protocol, Queue>::schedule(
+        std::vector<std::pair<ClientID, std::size_t>> const & scheduled) {
+        if (scheduled.empty()) {
+            return;
+        }
+        std::vector<bool> woken(this->networkers.size(), false);
+        for (auto node = scheduled.begin(); node != scheduled.end(); node++) {
+            this->networkers[node->second]->ready.push(node->first);
+        }
+        // Wake up each affected network thread once
+        for (auto node = scheduled.begin(); node != scheduled.end(); node++) {
+            if (!woken[node->second]) {
+                woken[node->second] = true;
+                this->wakeup(node->second);
             }
-            this->workers_mutex.unlock();
         }
     }
 
-    template <typename Protocol>
-    bool Server<Protocol>::sendNext() {
-        // Pick next from outgoing queue
-        Protocol object;
-        if (!this->out.pop(object)) {
-            return false;
+    template <typename Protocol, template <typename> class Queue>
+    void Server<Protocol, Queue>::throttle(std::vector<ClientID> const & full) {
+        for (auto id = full.begin(); id != full.end(); id++) {
+            while (this->isOnline()) {
+                auto drains = this->drains.load();
+                auto worker = this->workers.find(*id);
+                bool waiting = (worker != NULL && !worker->overflowed
+                                && !worker->detached
+                                && worker->queued > this->low_watermark);
+                if (!waiting) {
+                    break;
+                }
+                // Wait until any worker drained or left
+                this->drained.wait([this, drains]() {
+                    return this->drains.load() != drains;
+                }, std::chrono::milliseconds(100));
+            }
         }
-        // Get Worker's Link
-        this->workers_mutex.lock();
-        auto node = this->workers.find(object.client);
-        bool found = (node != this->workers.end());
-        this->workers_mutex.unlock();
-        if (!found || node->second == NULL) {
-            std::cerr << "Worker #" << object.client << " was not found"
-                      << std::endl << std::flush;
-            return false;
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    void Server<Protocol, Queue>::unqueue(Worker<Protocol, Queue> & worker,
+                                          std::size_t const bytes) {
+        auto before = worker.queued.fetch_sub(bytes);
+        if (this->high_watermark > 0 && before > this->low_watermark
+            && before - bytes <= this->low_watermark) {
+            // Resume threads waiting for this worker
+            this->drains++;
+            this->drained.notify();
+#ifdef NET_USE_COROUTINES
+            if (this->senders.notify(worker.id)) {
+                this->resumeLater();
+            }
+#endif
         }
-        sf::TcpSocket & link = node->second->link;
-        
-        // Send to Client
-        if (!object.send(link)) {
-            if (!node->second->isOnline()) {
-                // Pipe broken
-                link.disconnect();
-                this->workers_mutex.lock();
-                delete node->second;
-                this->workers.erase(node);
-                std::cerr << "Connection to the client #" << object.client
-                          << " was killed" << std::endl << std::flush;
-                this->workers_mutex.unlock();
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    void Server<Protocol, Queue>::trim(Worker<Protocol, Queue> & worker) {
+        // Keep the frames in order while looking for the oldest ones
+        utils::FramePtr frame;
+        while (worker.out.pop(frame)) {
+            worker.pending.push_back(std::move(frame));
+        }
+        std::size_t count = 0;
+        auto next = worker.pending.begin();
+        if (worker.offset > 0) {
+            // First frame is being sent
+            next++;
+        }
+        while (worker.queued > this->high_watermark
+               && next != worker.pending.end()) {
+            if (counted(*next) == 0) {
+                // Control frames are never dropped
+                next++;
+                continue;
             }
+            this->unqueue(worker, (*next)->size());
+            next = worker.pending.erase(next);
+            count++;
+        }
+        this->dropped += count;
+        this->release(count);
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    void Server<Protocol, Queue>::adopt(Worker<Protocol, Queue> & worker) {
+        auto & previous = worker.predecessor;
+        if (previous == NULL) {
+            return;
+        }
+        // Pushing threads release it before it can be found unreferenced
+        bool last = (previous.use_count() == 1);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        std::size_t bytes = 0;
+        utils::FramePtr frame;
+        while (previous->out.pop(frame)) {
+            bytes += counted(frame);
+            worker.pending.push_back(std::move(frame));
+        }
+        previous->queued -= bytes;
+        worker.queued += bytes;
+        if (last) {
+            // Nothing can be enqueued at it anymore
+            previous.reset();
+        }
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    void Server<Protocol, Queue>::discard(Worker<Protocol, Queue> & worker) {
+        std::size_t count = 0;
+        count += worker.pending.size();
+        worker.pending.clear();
+        worker.offset = 0;
+        utils::FramePtr frame;
+        while (worker.out.pop(frame)) {
+            count++;
+        }
+        worker.queued = 0;
+        this->dropped += count;
+        this->release(count);
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    void Server<Protocol, Queue>::release(std::size_t const count) {
+        if (count > 0 && this->backlog.fetch_sub(count) == count) {
+            // Everything was sent
+            this->sent.notify();
+        }
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    void Server<Protocol, Queue>::control(Worker<Protocol, Queue> & worker,
+                                          utils::Control const & message) {
+        // Not subject to the overflow policy, so it is never dropped
+        auto frame = message.encode();
+        auto position = worker.pending.begin();
+        if (worker.offset > 0) {
+            // First frame is being sent
+            position++;
+        }
+        worker.pending.insert(position, frame);
+        this->backlog++;
+        if (!worker.scheduled.exchange(true)) {
+            this->networkers[worker.networker]->requeued.push(worker.id);
+        }
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    bool Server<Protocol, Queue>::sendNext(Networker & networker) {
+        // Pick next scheduled worker
+        ClientID id;
+        if (!networker.ready.pop(id) && !networker.requeued.pop(id)) {
             return false;
         }
+        auto worker = this->workers.find(id);
+        if (worker == NULL) {
+            // Worker was removed in the meantime
+            return true;
+        }
+        if (worker->detached) {
+            // Objects are kept until the session is resumed, which applies
+            // the overflow policy (it might be resumed by another thread)
+            return true;
+        }
+        if (worker->overflowed) {
+            // Worker cannot receive fast enough
+            this->disconnect(id);
+            std::cerr << "Client #" << id << " was disconnected, because it"
+                      << " exceeded the high watermark" << std::endl
+                      << std::flush;
+            return true;
+        }
+        if (this->networkers[worker->networker].get() != &networker) {
+            // Worker resumed a session that was owned by this thread
+            this->networkers[worker->networker]->requeued.push(id);
+            this->wakeup(worker->networker);
+            return true;
+        }
+        if (this->overflow == Overflow::DropOldest
+            && this->high_watermark > 0
+            && worker->queued > this->high_watermark) {
+            this->trim(*worker);
+        }
+        // Objects pushed from now on will schedule the worker again
+        worker->scheduled = false;
+        if (!worker->blocked) {
+            // Otherwise wait until the link becomes writable
+            this->flush(*worker);
+        }
         return true;
     }
 
-    template <typename Protocol>
-    bool Server<Protocol>::receiveNext(ClientID const clientid,
-                                        sf::TcpSocket & link) {
-        // Try to receive next
-        Protocol object;
-        if (!object.receive(link)) {
-            // Cannot receive
-            if (!isOnline()) {
-                // Pipe broken
-                link.disconnect();
-                this->workers_mutex.lock();
-                auto node = this->workers.find(clientid);
-                if (node != this->workers.end()) {
-                    delete node->second;
-                    this->workers.erase(node);
-                    std::cerr << "Connection to the client #" << clientid
-                              << " was killed" << std::endl << std::flush;
+    template <typename Protocol, template <typename> class Queue>
+    bool Server<Protocol, Queue>::flush(Worker<Protocol, Queue> & worker) {
+        if (this->cork) {
+            utils::setCork(worker.link, true);
+        }
+        // Frames enqueued at a resumed session are sent first
+        this->adopt(worker);
+        utils::FramePtr frame;
+        while (true) {
+            // Collect a batch of frames
+            while (worker.pending.size() < this->batch_size
+                   && worker.out.pop(frame)) {
+                worker.pending.push_back(std::move(frame));
+            }
+            if (worker.pending.empty()) {
+                break;
+            }
+            // Send (the rest of) the batch to the client
+            auto end = worker.pending.end();
+            if (worker.pending.size() > this->batch_size) {
+                // Frames of a resumed session exceed the batch
+                end = worker.pending.begin() + this->batch_size;
+            }
+            std::size_t sent = 0;
+            auto status = utils::sendFrames(worker.link,
+                                            worker.pending.begin(), end,
+                                            worker.offset, sent);
+            // Drop all frames that were sent completely
+            std::size_t count = 0;
+            worker.offset += sent;
+            while (!worker.pending.empty()
+                   && worker.offset >= worker.pending.front()->size()) {
+                worker.offset -= worker.pending.front()->size();
+                this->unqueue(worker, counted(worker.pending.front()));
+                worker.traffic.send(worker.pending.front()->size());
+                this->networkers[worker.networker]->traffic.send(
+                    worker.pending.front()->size());
+#ifdef NET_PROFILE
+                this->profile.since(Stage::Outgoing,
+                                    worker.pending.front()->created());
+#endif
+                worker.pending.pop_front();
+                count++;
+            }
+            this->release(count);
+            if (status == sf::Socket::Done) {
+                continue;
+            }
+            if (status == sf::Socket::Partial
+                || status == sf::Socket::NotReady) {
+                // Link is busy: continue as soon as it is writable
+                if (this->cork) {
+                    utils::setCork(worker.link, false);
                 }
-                this->workers_mutex.unlock();
+                if (!worker.blocked) {
+                    worker.blocked = true;
+#ifdef NET_USE_EPOLL
+                    this->networkers[worker.networker]->poller.modify(
+                        utils::getHandle(worker.link), worker.id, true);
+#endif
+                }
+                return false;
             }
+            // Pipe broken
+            this->lost(worker);
+            return false;
+        }
+        if (this->cork) {
+            utils::setCork(worker.link, false);
+        }
+        if (worker.blocked) {
+            // Link is not observed for writability anymore
+            worker.blocked = false;
+#ifdef NET_USE_EPOLL
+            this->networkers[worker.networker]->poller.modify(
+                utils::getHandle(worker.link), worker.id, false);
+#endif
+        }
+        return true;
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    bool Server<Protocol, Queue>::receiveNext(Worker<Protocol, Queue> & worker) {
+        // Receive as many bytes as available
+        auto status = worker.reader.receive(worker.link);
+        if (status == sf::Socket::NotReady) {
+            // Nothing happened
+            return false;
+        }
+        if (status != sf::Socket::Done) {
+            // Pipe broken
+            this->lost(worker);
             return false;
         }
-        // Set Source ClientID
-        object.client = clientid;
-        // Push to incomming queue
-        this->in.push(object);
+#ifdef NET_PROFILE
+        auto received = utils::now();
+#endif
+        // Unpack all complete objects
+        char const * data;
+        std::size_t size;
+        std::uint32_t flags;
+        auto & traffic = this->networkers[worker.networker]->traffic;
+        while (worker.reader.next(data, size, flags)) {
+            worker.traffic.receive(size + utils::Frame::HEADER);
+            traffic.receive(size + utils::Frame::HEADER);
+            if (flags & utils::Frame::CONTROL) {
+                this->receiveControl(worker, data, size);
+                continue;
+            }
+            worker.received++;
+            if ((flags & utils::Frame::COMPRESSED)
+                && !worker.inflater.inflate(data, size)) {
+                std::cerr << "Cannot inflate object from client #"
+                          << worker.id << std::endl << std::flush;
+                continue;
+            }
+            CallID call = 0;
+            if ((flags & utils::Frame::CALL)
+                && !utils::takeCall(data, size, call)) {
+                std::cerr << "Invalid call from client #" << worker.id
+                          << std::endl << std::flush;
+                continue;
+            }
+            auto object = this->pool.acquire();
+            if (!object->decode(data, size, worker.packet)) {
+                std::cerr << "Cannot unpack object from client #"
+                          << worker.id << std::endl << std::flush;
+                continue;
+            }
+            // Set Source ClientID and the call to answer
+            object->client = worker.id;
+            object->call = call;
+#ifdef NET_PROFILE
+            object->received = received;
+            object->queued = utils::now();
+            this->profile.record(Stage::Receive, object->queued - received);
+#endif
+            // Push to the incomming queue of the responsible handler
+            auto index = this->shard(*object) % this->in.size();
+            this->in[index]->push(std::move(object));
+        }
+        if (worker.resilient && worker.acknowledged != worker.received) {
+            // Client can drop these objects from its replay buffer
+            worker.acknowledged = worker.received;
+            this->control(worker, utils::Control(utils::Control::Ack,
+                worker.id, 0, worker.received));
+        }
         return true;
     }
 
-    template <typename Protocol>
-    void Server<Protocol>::network_loop() {
+    template <typename Protocol, template <typename> class Queue>
+    void Server<Protocol, Queue>::receiveControl(
+        Worker<Protocol, Queue> & worker, char const * data,
+        std::size_t size) {
+        utils::Control request;
+        if (!request.decode(data, size, worker.packet)) {
+            std::cerr << "Invalid control message from client #" << worker.id
+                      << std::endl << std::flush;
+            return;
+        }
+        if (request.type == utils::Control::Compress) {
+            // Client inflates frames from now on
+            worker.inflates = true;
+            return;
+        }
+        if (request.type == utils::Control::Close) {
+            // Link is closed on purpose, so the session is not kept
+            worker.resilient = false;
+            return;
+        }
+        if (request.type != utils::Control::Session || worker.resilient) {
+            std::cerr << "Invalid control message from client #" << worker.id
+                      << std::endl << std::flush;
+            return;
+        }
+        if (request.token != 0 && this->session_timeout.count() > 0) {
+            // Resume the previous session if it is still kept
+            auto previous = this->workers.find(request.id);
+            if (previous != NULL && previous->token == request.token
+                && this->claim(*previous)) {
+                this->resume(worker, *previous, request.sequence);
+                return;
+            }
+            std::cerr << "Session of client #" << request.id << " cannot be"
+                      << " resumed by client #" << worker.id << std::endl
+                      << std::flush;
+        }
+        // Start a new session
+        worker.resilient = true;
+        worker.token = utils::createToken();
+        worker.received = request.sequence;
+        worker.acknowledged = request.sequence;
+        this->control(worker, utils::Control(utils::Control::Session,
+            worker.id, worker.token, worker.received));
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    void Server<Protocol, Queue>::resume(Worker<Protocol, Queue> & worker,
+                                         Worker<Protocol, Queue> & previous,
+                                         std::uint32_t const sequence) {
+        ClientID temporary = worker.id;
+        ClientID id = previous.id;
+        auto self = this->workers.find(temporary);
+        // Pushing threads might still enqueue at the previous worker
+        worker.predecessor = this->workers.find(id);
+        // Session is set up before the worker can be found by its ID
+        worker.resilient = true;
+        worker.token = previous.token;
+        // Take the previous worker's place and groups
+        this->groups_mutex.lock();
+        this->workers.erase(temporary);
+        this->workers.replace(id, self);
+        worker.id = id;
+        auto grouplist = worker.groups;
+        worker.groups = previous.groups;
+        this->groups_mutex.unlock();
+        for (auto n = grouplist.begin(); n != grouplist.end(); n++) {
+            this->ungroup(temporary, *n);
+        }
+#ifdef NET_USE_EPOLL
+        this->networkers[worker.networker]->poller.modify(
+            utils::getHandle(worker.link), id, worker.blocked);
+#endif
+        // Objects queued for the session are sent first
+        std::deque<utils::FramePtr> frames;
+        frames.swap(previous.pending);
+        previous.offset = 0;
+        // Objects enqueued at the previous worker from now on schedule it
+        // again, which is forwarded to this worker
+        previous.scheduled = false;
+        utils::FramePtr frame;
+        while (previous.out.pop(frame)) {
+            frames.push_back(std::move(frame));
+        }
+        std::size_t bytes = 0;
+        for (auto f = frames.begin(); f != frames.end(); f++) {
+            bytes += counted(*f);
+        }
+        previous.queued -= bytes;
+        worker.queued += bytes;
+        auto position = worker.pending.begin();
+        if (worker.offset > 0) {
+            // First frame is being sent
+            position++;
+        }
+        worker.pending.insert(position, frames.begin(), frames.end());
+        // Continue counting the client's objects
+        worker.received = previous.received;
+        if (std::int32_t(sequence - worker.received) > 0) {
+            std::cerr << (sequence - worker.received) << " objects of client #"
+                      << id << " were lost" << std::endl << std::flush;
+            worker.received = sequence;
+        }
+        worker.acknowledged = worker.received;
+        // Statistics cover the whole session
+        worker.traffic.add(previous.traffic);
+        if (previous.overflowed) {
+            // Disconnected by the next flush
+            worker.overflowed = true;
+        } else if (this->overflow == Overflow::DropOldest
+                   && this->high_watermark > 0
+                   && worker.queued > this->high_watermark) {
+            this->trim(worker);
+        }
+        this->networkers[previous.networker]->load--;
+        this->resumed++;
+        std::cerr << "Client #" << id << " resumed its session" << std::endl
+                  << std::flush;
+        this->control(worker, utils::Control(utils::Control::Session, id,
+            worker.token, worker.received));
+        // The previous worker is deleted as soon as no thread refers to it
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    void Server<Protocol, Queue>::lost(Worker<Protocol, Queue> & worker) {
+        ClientID id = worker.id;
+        if (!worker.resilient || this->session_timeout.count() == 0
+            || !this->isOnline()) {
+            this->disconnect(id);
+            std::cerr << "Connection to the client #" << id
+                      << " was killed" << std::endl << std::flush;
+            return;
+        }
+        // Keep the session until the client resumes it or it expires
+        worker.link.disconnect();
+        worker.reader.clear();
+        worker.blocked = false;
+        // Partially sent frame is sent again after resuming
+        worker.offset = 0;
+        worker.detached = std::max<std::uint64_t>(utils::now(), 1);
+        this->networkers[worker.networker]->detached.push_back(id);
+#ifdef NET_USE_COROUTINES
+        if (this->senders.notify(id)) {
+            // Objects are queued for the session without waiting
+            this->resumeLater();
+        }
+#endif
+        std::cerr << "Connection to the client #" << id << " was lost, its"
+                  << " session is kept" << std::endl << std::flush;
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    bool Server<Protocol, Queue>::claim(Worker<Protocol, Queue> & worker,
+                                        std::uint64_t const age) {
+        auto now = utils::now();
+        auto stamp = worker.detached.load();
+        while (stamp != 0 && stamp != Worker<Protocol, Queue>::CLAIMED
+               && (age == 0 || (stamp <= now && now - stamp >= age))) {
+            if (worker.detached.compare_exchange_weak(stamp,
+                    Worker<Protocol, Queue>::CLAIMED)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    void Server<Protocol, Queue>::expire(Networker & networker) {
+        auto timeout = std::uint64_t(std::chrono::duration_cast<
+            std::chrono::nanoseconds>(this->session_timeout).count());
+        auto & ids = networker.detached;
+        for (auto id = ids.begin(); id != ids.end();) {
+            auto worker = this->workers.find(*id);
+            if (worker == NULL || !worker->detached
+                || worker->detached == Worker<Protocol, Queue>::CLAIMED) {
+                // Session was resumed or closed
+                id = ids.erase(id);
+                continue;
+            }
+            if (this->claim(*worker, std::max<std::uint64_t>(timeout, 1))) {
+                // Cannot be resumed anymore
+                this->disconnect(*id);
+                std::cerr << "Session of client #" << *id << " expired"
+                          << std::endl << std::flush;
+                id = ids.erase(id);
+                continue;
+            }
+            id++;
+        }
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    void Server<Protocol, Queue>::network_loop(std::size_t const index) {
+        auto & networker = *this->networkers[index];
+#ifdef NET_USE_EPOLL
+        std::vector<utils::Poller::Event> events;
+        auto next_flush = std::chrono::steady_clock::now();
+        do {
+            int timeout = -1;
+            if (this->flush_interval.count() == 0) {
+                // Flush all scheduled workers
+                while (this->sendNext(networker)) {}
+            } else {
+                // Flush all scheduled workers once per interval
+                auto now = std::chrono::steady_clock::now();
+                if (now >= next_flush) {
+                    while (this->sendNext(networker)) {}
+                    next_flush = now + this->flush_interval;
+                }
+                timeout = int(std::chrono::duration_cast<
+                    std::chrono::milliseconds>(next_flush - now).count());
+            }
+            if (!networker.detached.empty()) {
+                // Check the kept sessions regularly
+                this->expire(networker);
+                timeout = (timeout < 0) ? 100 : std::min(timeout, 100);
+            }
+            // Wait for readiness of the workers or outgoing queue
+            networker.poller.wait(events, timeout);
+            for (auto e = events.begin(); e != events.end(); e++) {
+                if (e->token == utils::Poller::WAKEUP) {
+                    // Outgoing queue is handled above
+                    continue;
+                }
+                ClientID id = ClientID(e->token);
+                auto worker = this->workers.find(id);
+                if (worker == NULL) {
+                    // Worker was already removed
+                    continue;
+                }
+                if (e->writable && !e->closed) {
+                    // Continue sending
+                    if (!this->flush(*worker)) {
+                        // Worker is still blocked or was removed
+                        continue;
+                    }
+                }
+                if (e->readable || e->closed) {
+                    // Receive all pending objects (until the link broke)
+                    while (this->receiveNext(*worker)) {}
+                }
+            }
+        } while (this->isOnline());
+#else
         do {
             // Send all objects
-            while (this->sendNext());
-            // Receive from all workers
-            this->workers_mutex.lock();
-            auto workers = this->workers;
-            this->workers_mutex.unlock();
-            for (auto node = workers.begin(); node != workers.end(); node++) {
-                while (this->receiveNext(node->first, node->second->link)) {}
+            while (this->sendNext(networker));
+            if (!networker.detached.empty()) {
+                this->expire(networker);
             }
+            // Receive from all own workers
+            this->workers.forEach([this, index](ClientID const id,
+                std::shared_ptr<Worker<Protocol, Queue>> const & worker) {
+                if (worker->networker != index || worker->detached) {
+                    // Handled by another network thread or link was lost
+                    return;
+                }
+                if (worker->blocked && !this->flush(*worker)) {
+                    // Worker is still blocked or was removed
+                    return;
+                }
+                while (this->receiveNext(*worker)) {}
+            });
             // delay a bit
             utils::delay(25);
         } while (this->isOnline());
+#endif
     }
 
-    template <typename Protocol>
-    void Server<Protocol>::handle_loop() {
-        do {
-            // Pick next from incomming queue
-            Protocol object;            
-            if (!this->in.pop(object)) {
-                // Nothing to do
-                utils::delay(15);
-                continue;
+    template <typename Protocol, template <typename> class Queue>
+    void Server<Protocol, Queue>::handle_loop(std::size_t const index) {
+        auto & in = *this->in[index];
+        auto & timer = *this->timers[index];
+        std::vector<utils::Pooled<Protocol>> batch;
+        while (true) {
+            // Wait for objects (or the next coroutine to be resumed)
+            auto timeout = utils::FOREVER;
+#ifdef NET_USE_COROUTINES
+            if (index == 0) {
+                timeout = utils::until(utils::earliest(
+                    this->receivers.next(), this->senders.next()));
             }
-            // Trigger callback method
-            this->trigger(object.command, object);
-        } while (this->isOnline());
+#endif
+            if (in.waitPop(batch, 64, timeout) == 0 && this->closed
+                && in.size() == 0) {
+                // Incomming queue was closed
+                break;
+            }
+            for (auto object = batch.begin(); object != batch.end(); object++) {
+                auto command = (*object)->command;
+#ifdef NET_USE_COROUTINES
+                if (this->receivers.deliver(awaited((*object)->client,
+                                                    command), **object)) {
+                    // Awaited by a coroutine
+                    continue;
+                }
+#endif
+                auto start = utils::now();
+#ifdef NET_PROFILE
+                this->profile.record(Stage::Incoming,
+                                     start - (*object)->queued);
+#endif
+                // Trigger callback method
+                this->trigger(command, **object);
+                auto duration = utils::now() - start;
+#ifdef NET_PROFILE
+                this->profile.record(Stage::Handler, duration);
+#endif
+                timer.record(command, duration);
+            }
+            // Recycle the objects
+            batch.clear();
+#ifdef NET_USE_COROUTINES
+            if (index == 0) {
+                auto now = utils::now();
+                this->receivers.run(now);
+                this->senders.run(now);
+            }
+#endif
+        }
+#ifdef NET_USE_COROUTINES
+        if (index == 0) {
+            // Objects cannot be awaited anymore
+            this->receivers.cancel();
+            this->senders.cancel();
+        }
+#endif
     }
 
-    template <typename Protocol>
-    bool Server<Protocol>::start(std::uint16_t const port) {
+    template <typename Protocol, template <typename> class Queue>
+    bool Server<Protocol, Queue>::start(std::uint16_t const port) {
         if (this->isOnline()) {
             // already listening
             return true;
         }
-        // Start listener
-        auto status = this->listener.listen(port);
-        if (status != sf::Socket::Done) {
-            return false;
+        // Start listeners
+        for (auto acceptor = this->acceptors.begin();
+             acceptor != this->acceptors.end(); acceptor++) {
+            auto & listener = (*acceptor)->listener;
+#ifdef NET_USE_REUSEPORT
+            bool listening = (this->acceptors.size() > 1)
+                ? utils::listenShared(listener, port)
+                : (listener.listen(port) == sf::Socket::Done);
+#else
+            bool listening = (listener.listen(port) == sf::Socket::Done);
+#endif
+            if (!listening) {
+                for (auto other = this->acceptors.begin(); other != acceptor;
+                     other++) {
+                    (*other)->listener.close();
+                }
+                return false;
+            }
+            listener.setBlocking(false);
+        }
+        this->closed = false;
+        for (auto queue = this->in.begin(); queue != this->in.end(); queue++) {
+            (*queue)->reopen();
         }
-        this->listener.setBlocking(false);
         // Start threads
-        this->accepter = std::thread(&Server<Protocol>::accept_loop, this);
-        this->networker = std::thread(&Server<Protocol>::network_loop, this);
-        this->handler  = std::thread(&Server<Protocol>::handle_loop, this);
+        for (std::size_t i = 0; i < this->acceptors.size(); i++) {
+            auto & acceptor = *this->acceptors[i];
+#ifdef NET_USE_EPOLL
+            acceptor.poller.add(utils::getHandle(acceptor.listener), 0);
+#endif
+            acceptor.thread = std::thread(
+                &Server<Protocol, Queue>::accept_loop, this, i);
+        }
+        for (std::size_t i = 0; i < this->networkers.size(); i++) {
+            this->networkers[i]->thread = std::thread(
+                &Server<Protocol, Queue>::network_loop, this, i);
+        }
+        for (std::size_t i = 0; i < this->in.size(); i++) {
+            this->handlers.push_back(std::thread(
+                &Server<Protocol, Queue>::handle_loop, this, i));
+        }
         
         return true;
     }
 
-    template <typename Protocol>
-    void Server<Protocol>::shutdown() {
-        // wait until outgoing queue is empty
+    template <typename Protocol, template <typename> class Queue>
+    bool Server<Protocol, Queue>::setHandlers(std::size_t const number) {
+        if (number == 0 || this->isOnline()) {
+            return false;
+        }
+        this->in.clear();
+        this->timers.clear();
+        for (std::size_t i = 0; i < number; i++) {
+            this->in.emplace_back(new Queue<utils::Pooled<Protocol>>());
+            this->timers.emplace_back(new utils::CommandTimer());
+        }
+        return true;
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    bool Server<Protocol, Queue>::setNetworkers(std::size_t const number) {
+        if (number == 0 || this->isOnline()) {
+            return false;
+        }
+        this->networkers.clear();
+        for (std::size_t i = 0; i < number; i++) {
+            this->networkers.emplace_back(new Networker());
+        }
+        return true;
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    bool Server<Protocol, Queue>::setAcceptors(std::size_t const number) {
+#ifndef NET_USE_REUSEPORT
+        if (number > 1) {
+            // Listeners cannot share the port
+            return false;
+        }
+#endif
+        if (number == 0
+            || (!this->acceptors.empty() && this->isOnline())) {
+            return false;
+        }
+        this->acceptors.clear();
+        for (std::size_t i = 0; i < number; i++) {
+            this->acceptors.emplace_back(new Acceptor());
+        }
+        return true;
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    bool Server<Protocol, Queue>::setBatchSize(std::size_t const size) {
+        if (size == 0 || this->isOnline()) {
+            return false;
+        }
+        this->batch_size = std::min(size, utils::MAX_BATCH);
+        return true;
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    bool Server<Protocol, Queue>::setFlushInterval(
+        std::chrono::milliseconds const interval) {
+        if (this->isOnline()) {
+            return false;
+        }
+        this->flush_interval = interval;
+        return true;
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    bool Server<Protocol, Queue>::setTcpOptions(bool const nodelay,
+                                                bool const cork) {
+        if (this->isOnline()) {
+            return false;
+        }
+        this->nodelay = nodelay;
+        this->cork = cork;
+        return true;
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    bool Server<Protocol, Queue>::setWatermarks(std::size_t const low,
+                                                std::size_t const high,
+                                                Overflow const policy) {
+        if (low > high || this->isOnline()) {
+            return false;
+        }
+        this->low_watermark = low;
+        this->high_watermark = high;
+        this->overflow = policy;
+        return true;
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    bool Server<Protocol, Queue>::setSessionTimeout(
+        std::chrono::milliseconds const timeout) {
+        if (this->isOnline()) {
+            return false;
+        }
+        this->session_timeout = timeout;
+        return true;
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    bool Server<Protocol, Queue>::setCompression(std::size_t const threshold,
+                                                 int const level) {
+        if (this->isOnline()) {
+            return false;
+        }
+        return this->compression.configure(threshold, level);
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    void Server<Protocol, Queue>::shutdown() {
+        // wait until all outgoing queues are empty
         // @note: data that is pushed while this queue is waiting might be lost
-        while (this->isOnline() && !this->out.isEmpty()) {
-            utils::delay(15);
+        auto done = [this]() { return this->backlog.load() == 0; };
+        while (this->isOnline()
+               && !this->sent.wait(done, std::chrono::milliseconds(100))) {
+            // Kept sessions cannot be sent to
+            this->workers.forEach([this](ClientID const id,
+                std::shared_ptr<Worker<Protocol, Queue>> const & worker) {
+                if (this->claim(*worker)) {
+                    this->disconnect(id);
+                }
+            });
         }
         this->disconnect();
     }
 
-    template <typename Protocol>
-    void Server<Protocol>::disconnect() {
-        // shutdown listener
-        this->listener.close();
+    template <typename Protocol, template <typename> class Queue>
+    void Server<Protocol, Queue>::disconnect() {
+        // shutdown listeners
+        for (auto acceptor = this->acceptors.begin();
+             acceptor != this->acceptors.end(); acceptor++) {
+            (*acceptor)->listener.close();
+#ifdef NET_USE_EPOLL
+            (*acceptor)->poller.wakeup();
+#endif
+        }
+        for (std::size_t i = 0; i < this->networkers.size(); i++) {
+            this->wakeup(i);
+        }
+        this->closed = true;
+        for (auto queue = this->in.begin(); queue != this->in.end(); queue++) {
+            (*queue)->close();
+        }
         // shutdown threads (try-catched, they might have been stopped, yet)
-        try {
-            this->accepter.join();
-        } catch (std::system_error const & se) {}
-        try {
-            this->networker.join();
-        } catch (std::system_error const & se) {}
-        try {
-            this->handler.join();
-        } catch (std::system_error const & se) {}
-        this->workers_mutex.lock();
-        // disconnect workers
-        for (auto node = this->workers.begin(); node != this->workers.end();
-             node++) {
-            if (node->second != NULL) {
-                delete node->second;
-                node->second = NULL;
-            }
+        for (auto acceptor = this->acceptors.begin();
+             acceptor != this->acceptors.end(); acceptor++) {
+            try {
+                (*acceptor)->thread.join();
+            } catch (std::system_error const & se) {}
+        }
+        for (auto networker = this->networkers.begin();
+             networker != this->networkers.end(); networker++) {
+            try {
+                (*networker)->thread.join();
+            } catch (std::system_error const & se) {}
         }
-        this->workers_mutex.unlock();
+        for (auto thread = this->handlers.begin();
+             thread != this->handlers.end(); thread++) {
+            try {
+                thread->join();
+            } catch (std::system_error const & se) {}
+        }
+        this->handlers.clear();
+        // disconnect workers
+        this->workers.forEach([this](ClientID const id,
+            std::shared_ptr<Worker<Protocol, Queue>> const &) {
+            this->workers.erase(id);
+        });
         this->groups.clear();
-        this->workers.clear();
-        this->next_id = 0;
-        // clear queue
-        this->out.clear();
-        this->in.clear();
+        // clear queues
+        for (auto networker = this->networkers.begin();
+             networker != this->networkers.end(); networker++) {
+            (*networker)->ready.clear();
+            (*networker)->requeued.clear();
+            (*networker)->load = 0;
+        }
+        for (auto queue = this->in.begin(); queue != this->in.end(); queue++) {
+            (*queue)->clear();
+        }
     }
 
-    template <typename Protocol>
-    void Server<Protocol>::disconnect(ClientID const id) {
-        this->workers_mutex.lock();
-        auto node = this->workers.find(id);
-        if (node != this->workers.end()) {
-            // remove worker from groups
-            auto grouplist = node->second->groups;
-            for (auto n = grouplist.begin(); n != grouplist.end(); n++) {
-                this->ungroup(id, *n);
-            }
-            // delete worker
-            delete node->second;
-            this->workers.erase(node);
+    template <typename Protocol, template <typename> class Queue>
+    ServerStats Server<Protocol, Queue>::getStats() {
+        ServerStats stats;
+        stats.time = utils::now();
+        stats.clients = this->workers.size();
+        stats.accepted = this->accepted;
+        stats.refused = this->refused;
+        stats.disconnected = this->disconnected;
+        stats.resumed = this->resumed;
+        stats.dropped = this->dropped;
+        for (auto queue = this->in.begin(); queue != this->in.end(); queue++) {
+            stats.incoming += (*queue)->size();
+        }
+        stats.outgoing = this->backlog;
+        for (auto networker = this->networkers.begin();
+             networker != this->networkers.end(); networker++) {
+            (*networker)->traffic.collect(stats.total);
+        }
+        this->workers.forEach([&stats](ClientID const id,
+            std::shared_ptr<Worker<Protocol, Queue>> const & worker) {
+            auto & link = stats.links[id];
+            worker->traffic.collect(link);
+            link.queued = worker->queued;
+            stats.total.queued += link.queued;
+        });
+        for (auto timer = this->timers.begin(); timer != this->timers.end();
+             timer++) {
+            (*timer)->collect(stats.commands);
+        }
+        return stats;
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    void Server<Protocol, Queue>::disconnect(ClientID const id) {
+        auto worker = this->workers.erase(id);
+        if (worker == NULL) {
+            // already removed
+            return;
+        }
+        this->disconnected++;
+        // remove worker from groups
+        this->groups_mutex.lock();
+        auto grouplist = worker->groups;
+        this->groups_mutex.unlock();
+        for (auto n = grouplist.begin(); n != grouplist.end(); n++) {
+            this->ungroup(id, *n);
+        }
+        this->networkers[worker->networker]->load--;
+        if (this->high_watermark > 0) {
+            // Resume threads waiting for this worker
+            this->drains++;
+            this->drained.notify();
+        }
+#ifdef NET_USE_COROUTINES
+        // Resume coroutines waiting for this worker
+        bool notified = this->senders.notify(id);
+        if (this->receivers.notifyIf([id](std::uint64_t const key) {
+                return ClientID(key >> 32) == id;
+            }) || notified) {
+            this->resumeLater();
+        }
+#endif
+        // The worker is deleted (and its outgoing objects are dropped) as
+        // soon as no network or pushing thread refers to it anymore
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    void Server<Protocol, Queue>::push(Protocol & object, ClientID const id) {
+        // Set target client
+        object.client = id;
+        // Encode and push to the worker's outgoing queue
+        auto frame = utils::encode(object);
+        if (frame == NULL) {
+            std::cerr << "Cannot pack #" << object.command << std::endl
+                      << std::flush;
+            return;
+        }
+        this->deliver(frame, &id, &id + 1);
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    void Server<Protocol, Queue>::reply(Protocol const & request,
+                                        Protocol & response) {
+        if (request.call == 0) {
+            this->push(response, request.client);
+            return;
+        }
+        // Set target client and tag the response with the call's ID
+        auto id = request.client;
+        response.client = id;
+        response.call = request.call;
+        auto frame = utils::encodeCall(response, request.call);
+        if (frame == NULL) {
+            std::cerr << "Cannot pack #" << response.command << std::endl
+                      << std::flush;
+            return;
         }
-        this->workers_mutex.unlock();
+        this->deliver(frame, &id, &id + 1);
     }
 
-    template <typename Protocol>
-    void Server<Protocol>::push(Protocol & object) {
-        this->workers_mutex.lock();
-        auto workers = this->workers;
-        this->workers_mutex.unlock();
-        for (auto node = workers.begin(); node != workers.end(); node++) {
-            if (node->second != NULL && node->second->isOnline()) {
-                // Set Target ClientID
-                object.client = node->first;
-                this->out.push(object);
+#ifdef NET_USE_COROUTINES
+    template <typename Protocol, template <typename> class Queue>
+    utils::Awaiter<Protocol> Server<Protocol, Queue>::await(
+        std::chrono::milliseconds const timeout) {
+        // Do not suspend if the handler threads are not running
+        utils::Awaiter<Protocol> awaiter((this->isOnline() && !this->closed)
+                                         ? &this->receivers : NULL);
+        awaiter.within(timeout);
+        awaiter.suspended = [this](bool const earliest) {
+            if (earliest) {
+                // First handler waits for a later deadline
+                this->resumeLater();
             }
+        };
+        return awaiter;
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    utils::Awaiter<Protocol> Server<Protocol, Queue>::receive(
+        ClientID const client, CommandID const command,
+        std::chrono::milliseconds const timeout) {
+        auto awaiter = this->await(timeout);
+        awaiter.on(awaited(client, command));
+        return awaiter;
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    utils::Awaiter<Protocol> Server<Protocol, Queue>::send(Protocol & object,
+                                                           ClientID const id) {
+        utils::Awaiter<Protocol> ready(NULL);
+        // Set target client
+        object.client = id;
+        // Encode and push to the worker's outgoing queue
+        auto frame = utils::encode(object);
+        if (frame == NULL) {
+            std::cerr << "Cannot pack #" << object.command << std::endl
+                      << std::flush;
+            return ready;
+        }
+        auto worker = this->workers.find(id);
+        if (worker == NULL) {
+            std::cerr << "Worker #" << id << " was not found" << std::endl
+                      << std::flush;
+            return ready;
+        }
+        utils::FramePtr compressed;
+        if (this->enqueue(*worker,
+                          this->outgoing(*worker, frame, compressed))) {
+            this->schedule(std::vector<std::pair<ClientID, std::size_t>>(1,
+                std::make_pair(id, worker->networker)));
+        }
+        if (!this->isFull(*worker) || this->closed) {
+            return ready;
         }
+        // Wait until the worker drained (unless it did meanwhile)
+        utils::Awaiter<Protocol> awaiter(&this->senders);
+        awaiter.on(id);
+        awaiter.blocked = [this, id]() {
+            auto worker = this->workers.find(id);
+            return (worker != NULL && !worker->overflowed
+                    && !worker->detached
+                    && worker->queued > this->low_watermark);
+        };
+        return awaiter;
     }
+#endif
 
-    template <typename Protocol>
-    void Server<Protocol>::pushGroup(Protocol & object, GroupID const group) {
-        this->groups_mutex.lock();
-        auto node = this->groups.find(group);
-        if (node == this->groups.end()) {
+    template <typename Protocol, template <typename> class Queue>
+    void Server<Protocol, Queue>::push(Protocol & object) {
+        // Encode once for all workers
+        auto frame = utils::encode(object);
+        if (frame == NULL) {
+            std::cerr << "Cannot pack #" << object.command << std::endl
+                      << std::flush;
+            return;
+        }
+        std::vector<std::pair<ClientID, std::size_t>> scheduled;
+        std::vector<ClientID> full;
+        utils::FramePtr compressed;
+        this->workers.forEach([&](ClientID const id,
+            std::shared_ptr<Worker<Protocol, Queue>> const & worker) {
+            if (!worker->isOnline() && !worker->detached) {
+                return;
+            }
+            if (this->enqueue(*worker,
+                              this->outgoing(*worker, frame, compressed))) {
+                scheduled.emplace_back(id, worker->networker);
+            }
+            if (this->isFull(*worker)) {
+                full.push_back(id);
+            }
+        });
+        this->schedule(scheduled);
+        this->throttle(full);
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    void Server<Protocol, Queue>::pushGroup(Protocol & object,
+                                            GroupID const group) {
+        // Snapshot stays valid while the group is modified
+        auto clients = this->groups.find(group);
+        if (clients == NULL) {
             // group does not exist
-            this->groups_mutex.unlock();
             return;
         }
-        // push to all group's clients
-        for (auto n = node->second.begin(); n != node->second.end(); n++) {
-            this->push(object, *n);
+        // Encode once for all group's clients
+        auto frame = utils::encode(object);
+        if (frame == NULL) {
+            std::cerr << "Cannot pack #" << object.command << std::endl
+                      << std::flush;
+            return;
+        }
+        std::vector<ClientID> missing;
+        this->deliver(frame, clients->begin(), clients->end(), &missing);
+        if (!missing.empty()) {
+            // IDs are never reused, so stale members can be dropped safely
+            this->groups_mutex.lock();
+            this->groups.erase(group, missing.begin(), missing.end());
+            this->groups_mutex.unlock();
         }
-        this->groups_mutex.unlock();
     }
 
-    template <typename Protocol>
-    void Server<Protocol>::group(ClientID const client, GroupID const group) {
+    template <typename Protocol, template <typename> class Queue>
+    void Server<Protocol, Queue>::group(ClientID const client, GroupID const group) {
+        this->group(std::vector<ClientID>(1, client), group);
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    void Server<Protocol, Queue>::group(std::vector<ClientID> const & clients,
+                                        GroupID const group) {
+        std::vector<ClientID> found;
+        found.reserve(clients.size());
         this->groups_mutex.lock();
-        auto node = this->groups.find(group);
-        if (node == this->groups.end()) {
-            // group does not exist, yet
-            this->groups[group] = std::set<ClientID>();
-            this->groups[group].insert(client);
-        } else {
-            // group does already exist
-            node->second.insert(client);
-        }
-        // add this group to the clients groups
-        auto n = this->workers.find(client);
-        if (n != this->workers.end()) {
-            n->second->groups.insert(group);
+        // add this group to the clients groups; a client that is already
+        // disconnecting would never be ungrouped, so it is skipped
+        for (auto id = clients.begin(); id != clients.end(); id++) {
+            auto worker = this->workers.find(*id);
+            if (worker != NULL) {
+                worker->groups.insert(group);
+                found.push_back(*id);
+            }
         }
+        this->groups.insert(group, found.begin(), found.end());
         this->groups_mutex.unlock();
     }
 
-    template <typename Protocol>
-    void Server<Protocol>::ungroup(ClientID const client,
+    template <typename Protocol, template <typename> class Queue>
+    void Server<Protocol, Queue>::ungroup(ClientID const client,
                                     GroupID const group) {
+        this->ungroup(std::vector<ClientID>(1, client), group);
+    }
+
+    template <typename Protocol, template <typename> class Queue>
+    void Server<Protocol, Queue>::ungroup(
+        std::vector<ClientID> const & clients, GroupID const group) {
         this->groups_mutex.lock();
-        auto node = this->groups.find(group);
-        if (node == this->groups.end()) {
-            // group does not exist
-            this->groups_mutex.unlock();
-            return;
-        }
         // remove from group
-        node->second.erase(client);
-        // add this group to the clients groups
-        auto n = this->workers.find(client);
-        if (n != this->workers.end()) {
-            n->second->groups.erase(group);
+        this->groups.erase(group, clients.begin(), clients.end());
+        // remove this group from the clients groups
+        for (auto id = clients.begin(); id != clients.end(); id++) {
+            auto worker = this->workers.find(*id);
+            if (worker != NULL) {
+                worker->groups.erase(group);
+            }
         }
         this->groups_mutex.unlock();
     }
 
-    template <typename Protocol>
-    std::set<ClientID> Server<Protocol>::getClients(GroupID const group) {
-        this->groups_mutex.lock();
-        auto node = this->groups.find(group);
-        if (node == this->groups.end()) {
+    template <typename Protocol, template <typename> class Queue>
+    std::set<ClientID> Server<Protocol, Queue>::getClients(GroupID const group) {
+        auto clients = this->groups.find(group);
+        if (clients == NULL) {
             // group does not exist
-            this->groups_mutex.unlock();
             return std::set<ClientID>();
         }
-        auto g = node->second;
-        this->groups_mutex.unlock();
-        // return group
-        return g;
+        return std::set<ClientID>(clients->begin(), clients->end());
     }
 
-    template <typename Protocol>
-    bool Server<Protocol>::hasGroup(GroupID const group) {
-        this->groups_mutex.lock();
-        auto node = this->groups.find(group);
-        bool has = (node != this->groups.end());
-        this->groups_mutex.unlock();
-        return has;
+    template <typename Protocol, template <typename> class Queue>
+    bool Server<Protocol, Queue>::hasGroup(GroupID const group) {
+        return this->groups.has(group);
     }
 
 }
@@ -0,0 +1,297 @@
+/*
+Copyright (c) 2013 Christian Glöckner <cgloeckner@freenet.de>
+
+This file is part of the networking module:
+    https://github.com/cgloeckner/networking
+
+It offers a tcp-based server-client framework for games and other software.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#ifndef NET_SESSION_INCLUDE_GUARD
+#define NET_SESSION_INCLUDE_GUARD
+
+#include <deque>
+#include <chrono>
+#include <random>
+#include <memory>
+#include <cstdint>
+#include <algorithm>
+
+#include <SFML/Network.hpp>
+
+#include <net/common.hpp>
+#include <net/frame.hpp>
+
+namespace net {
+
+    namespace utils {
+
+        /// Message exchanged by client and server to maintain a session
+        /**
+         * Control messages are sent as frames flagged by `Frame::CONTROL`, so
+         *  they never reach the protocol. A resilient client sends a
+         *  `Session` message right after it received its ClientID. It
+         *  presents the ID and token of its previous session (if any) and
+         *  the sequence number of the oldest message it is able to replay.
+         *  The server answers by the session the client belongs to from now
+         *  on and the number of the client's messages it received within
+         *  this session. Afterwards, the server acknowledges received
+         *  messages by `Ack` messages. A client that disconnects on purpose
+         *  sends `Close`, so its session is not kept. A client that is able
+         *  to inflate frames sends `Compress` before anything else, so the
+         *  server compresses frames to it (see <net/compress.hpp>).
+         */
+        struct Control {
+            /// Type of a control message
+            enum Type {
+                /// Request (client) or grant (server) of a session
+                Session = 1,
+                /// Number of the client's messages the server received
+                Ack = 2,
+                /// Client ends its session
+                Close = 3,
+                /// Client inflates compressed frames
+                Compress = 4
+            };
+
+            /// type of the message
+            Type type;
+            /// client ID of the session
+            ClientID id;
+            /// secret token of the session (0 = none)
+            std::uint64_t token;
+            /// sequence number (see above)
+            std::uint32_t sequence;
+
+            /// Constructor
+            Control(Type const type=Ack, ClientID const id=0,
+                    std::uint64_t const token=0,
+                    std::uint32_t const sequence=0)
+                : type(type)
+                , id(id)
+                , token(token)
+                , sequence(sequence) {
+            }
+
+            /// Encode the message into a control frame
+            /**
+             *  @return frame
+             */
+            FramePtr encode() const {
+                auto frame = std::make_shared<Frame>();
+                frame->body() << sf::Uint8(this->type)
+                              << sf::Uint32(this->id)
+                              << sf::Uint32(this->token >> 32)
+                              << sf::Uint32(this->token & 0xFFFFFFFFu)
+                              << sf::Uint32(this->sequence);
+                frame->seal(Frame::CONTROL);
+                return frame;
+            }
+
+            /// Decode the message from the data of a control frame
+            /**
+             *  @param data: received bytes
+             *  @param size: number of bytes
+             *  @param packet: reusable packet
+             *  @return true in case of success
+             */
+            bool decode(char const * data, std::size_t size,
+                        sf::Packet & packet) {
+                packet.clear();
+                packet.append(data, size);
+                sf::Uint8 type = 0;
+                sf::Uint32 id = 0, high = 0, low = 0, sequence = 0;
+                if (!(packet >> type >> id >> high >> low >> sequence)
+                    || type < Session || type > Compress) {
+                    return false;
+                }
+                this->type = Type(type);
+                this->id = id;
+                this->token = (std::uint64_t(high) << 32) | low;
+                this->sequence = sequence;
+                return true;
+            }
+        };
+
+        /// Create a random session token
+        /**
+         * Tokens are taken from `std::random_device`, so they cannot be
+         *  guessed from the tokens of other sessions.
+         *  @return non-zero token
+         */
+        inline std::uint64_t createToken() {
+            static thread_local std::random_device device;
+            std::uint64_t token;
+            do {
+                token = (std::uint64_t(device()) << 32) | device();
+            } while (token == 0);
+            return token;
+        }
+
+        /// Sent messages that were not acknowledged, yet
+        /**
+         * The n-th message sent within a session has the sequence number n.
+         *  Messages are kept until the server acknowledged them. If the
+         *  buffer is full, the oldest message is dropped and cannot be
+         *  replayed anymore. The buffer is used by a single thread only.
+         */
+        class ReplayBuffer {
+            protected:
+                /// sent frames starting with the oldest one
+                std::deque<FramePtr> frames;
+                /// sequence number of the oldest frame
+                std::uint32_t first;
+                /// maximum number of frames
+                std::size_t capacity;
+
+            public:
+                /// Constructor
+                /**
+                 *  @param capacity: maximum number of frames
+                 */
+                ReplayBuffer(std::size_t const capacity=1024)
+                    : first(0)
+                    , capacity(capacity) {
+                }
+
+                /// Set the maximum number of frames
+                inline void setCapacity(std::size_t const capacity) {
+                    this->capacity = capacity;
+                }
+
+                /// Add a frame that was sent completely
+                void push(FramePtr const & frame) {
+                    if (this->frames.size() >= this->capacity) {
+                        if (this->frames.empty()) {
+                            // nothing is kept at all
+                            this->first++;
+                            return;
+                        }
+                        this->frames.pop_front();
+                        this->first++;
+                    }
+                    this->frames.push_back(frame);
+                }
+
+                /// Drop all frames the server received
+                /**
+                 *  @param received: number of messages the server received
+                 */
+                void acknowledge(std::uint32_t const received) {
+                    // sequence numbers may wrap around
+                    while (!this->frames.empty()
+                           && std::int32_t(received - this->first) > 0) {
+                        this->frames.pop_front();
+                        this->first++;
+                    }
+                }
+
+                /// Move all frames in front of the given frames
+                /**
+                 * The frames get the same sequence numbers when they are
+                 *  pushed again after they were sent.
+                 *  @param target: frames that are about to be sent
+                 *  @return number of moved frames
+                 */
+                std::size_t replay(std::deque<FramePtr> & target) {
+                    auto count = this->frames.size();
+                    target.insert(target.begin(), this->frames.begin(),
+                                  this->frames.end());
+                    this->frames.clear();
+                    return count;
+                }
+
+                /// Drop all frames and continue with the given sequence number
+                inline void reset(std::uint32_t const sequence=0) {
+                    this->frames.clear();
+                    this->first = sequence;
+                }
+
+                /// Returns the sequence number of the oldest frame
+                /**
+                 * This is the sequence number of the next frame if the
+                 *  buffer is empty.
+                 *  @return sequence number
+                 */
+                inline std::uint32_t base() const {
+                    return this->first;
+                }
+
+                /// Returns the number of frames
+                inline std::size_t size() const {
+                    return this->frames.size();
+                }
+        };
+
+        /// Delays between reconnection attempts
+        /**
+         * The delay doubles with each attempt, from `min` up to `max`. The
+         *  actual delay is chosen randomly between half and all of it, so
+         *  clients that lost their links at the same time do not flood the
+         *  server by reconnecting at the same time.
+         */
+        class Backoff {
+            protected:
+                /// first and largest delay
+                std::chrono::milliseconds min, max;
+                /// delay of the next attempt
+                std::chrono::milliseconds current;
+                /// source of the jitter
+                std::minstd_rand random;
+
+            public:
+                /// Constructor
+                /**
+                 *  @param min: delay of the first attempt
+                 *  @param max: largest delay
+                 */
+                Backoff(std::chrono::milliseconds const min
+                            = std::chrono::milliseconds(100),
+                        std::chrono::milliseconds const max
+                            = std::chrono::milliseconds(10000))
+                    : min(min)
+                    , max(std::max(min, max))
+                    , current(min)
+                    , random(std::random_device()()) {
+                }
+
+                /// Start again with the first delay
+                inline void reset() {
+                    this->current = this->min;
+                }
+
+                /// Returns the delay of the next attempt
+                std::chrono::milliseconds next() {
+                    auto delay = this->current.count();
+                    this->current = std::min(this->current * 2, this->max);
+                    std::uniform_int_distribution<
+                        std::chrono::milliseconds::rep> jitter(delay / 2,
+                                                               delay);
+                    return std::chrono::milliseconds(jitter(this->random));
+                }
+        };
+
+    }
+
+}
+
+#endif // NET_SESSION_INCLUDE_GUARD
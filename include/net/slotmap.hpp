@@ -0,0 +1,296 @@
+/*
+Copyright (c) 2013 Christian Glöckner <cgloeckner@freenet.de>
+
+This file is part of the networking module:
+    https://github.com/cgloeckner/networking
+
+It offers a tcp-based server-client framework for games and other software.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#ifndef NET_SLOTMAP_INCLUDE_GUARD
+#define NET_SLOTMAP_INCLUDE_GUARD
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+/// Number of bits of a key that address the slot (the rest is a generation):
+/// at most 2^NET_SLOT_BITS objects at once, 2^(32 - NET_SLOT_BITS) keys per slot
+#ifndef NET_SLOT_BITS
+#define NET_SLOT_BITS 20
+#endif
+
+namespace net {
+
+    namespace utils {
+
+        /// Map of shared objects keyed by generational keys
+        /**
+         * Each key consists of a slot index (lower NET_SLOT_BITS bits) and
+         *  the slot's generation (upper bits). The generation is increased
+         *  whenever a slot is released, so stale keys are detected. Released
+         *  slots are reused in FIFO order, and a slot is retired once all
+         *  of its generations were used, so a key is never handed out twice.
+         *  Hence at most 2^32 - 1 keys can be reserved over the lifetime of
+         *  the map; more slot bits allow more objects at once, but fewer
+         *  generations per slot. Slots are
+         *  allocated in pages which are never moved, so `find` and `forEach`
+         *  work without locking the map: they take a reference to the object,
+         *  which keeps it alive even if it is erased in the meantime.
+         *  Inserting and erasing is serialized by a mutex.
+         */
+        template <typename T>
+        class SlotMap {
+            public:
+                /// Key type
+                typedef std::uint32_t Key;
+                /// Key that never refers to an object
+                static Key const INVALID = ~Key(0);
+                /// Maximum number of objects
+                static std::size_t const CAPACITY =
+                    std::size_t(1) << NET_SLOT_BITS;
+                /// Number of slots allocated at once
+                static std::size_t const PAGE = 1024;
+                /// Number of generations of each slot
+                static Key const GENERATIONS = Key(1) << (32 - NET_SLOT_BITS);
+
+                static_assert(NET_SLOT_BITS >= 10 && NET_SLOT_BITS < 32,
+                              "NET_SLOT_BITS must be between 10 and 31");
+
+            protected:
+                /// Slot holding an object
+                struct Slot {
+                    /// object (accessed by std::atomic_load/store)
+                    std::shared_ptr<T> value;
+                    /// key of the object or INVALID
+                    std::atomic<Key> key;
+                    /// generation of the current or next object
+                    Key generation;
+                    /// whether the slot is reserved or used
+                    bool taken;
+
+                    Slot()
+                        : key(INVALID)
+                        , generation(0)
+                        , taken(false) {
+                    }
+                };
+
+                /// pages of slots
+                std::atomic<Slot*> pages[CAPACITY / PAGE];
+                /// number of slots that were ever taken
+                std::atomic<std::size_t> used;
+                /// number of objects
+                std::atomic<std::size_t> count;
+                /// indices of released slots (oldest first)
+                std::deque<std::size_t> unused;
+                /// mutex for inserting and erasing
+                std::mutex mutex;
+
+                /// Returns the slot of an index (or NULL)
+                inline Slot * at(std::size_t const index) const {
+                    auto page = this->pages[index / PAGE].load(
+                        std::memory_order_acquire);
+                    return (page != NULL) ? &page[index % PAGE] : NULL;
+                }
+
+                /// Returns the slot of a key (or NULL)
+                inline Slot * at(Key const key) const {
+                    return this->at(std::size_t(key & (CAPACITY - 1)));
+                }
+
+                /// Build a key from generation and index
+                static inline Key build(Key const generation,
+                                        std::size_t const index) {
+                    return Key((generation << NET_SLOT_BITS) | index);
+                }
+
+            public:
+                /// Constructor
+                SlotMap()
+                    : used(0)
+                    , count(0) {
+                    for (std::size_t i = 0; i < CAPACITY / PAGE; i++) {
+                        this->pages[i].store(NULL);
+                    }
+                }
+
+                /// Destructor
+                virtual ~SlotMap() {
+                    for (std::size_t i = 0; i < CAPACITY / PAGE; i++) {
+                        delete[] this->pages[i].load();
+                    }
+                }
+
+                /// Reserve a key for an object
+                /**
+                 * The key does not refer to an object until it was passed to
+                 *  `insert`. An unused key must be released using `erase`.
+                 *  @return key or INVALID if the map is full
+                 */
+                Key reserve() {
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    while (true) {
+                        std::size_t index;
+                        if (!this->unused.empty()) {
+                            // Reuse the slot that was released first
+                            index = this->unused.front();
+                            this->unused.pop_front();
+                        } else if (this->used < CAPACITY) {
+                            index = this->used;
+                            if (index % PAGE == 0) {
+                                this->pages[index / PAGE].store(
+                                    new Slot[PAGE], std::memory_order_release);
+                            }
+                            this->used.store(index + 1,
+                                             std::memory_order_release);
+                        } else {
+                            return INVALID;
+                        }
+                        auto slot = this->at(index);
+                        auto key = build(slot->generation, index);
+                        if (key == INVALID) {
+                            // Last generation of the last slot: retire it
+                            slot->generation++;
+                            continue;
+                        }
+                        slot->taken = true;
+                        return key;
+                    }
+                }
+
+                /// Insert an object using a reserved key
+                /**
+                 *  @param key: reserved key
+                 *  @param value: object
+                 */
+                void insert(Key const key, std::shared_ptr<T> value) {
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    auto slot = this->at(key);
+                    std::atomic_store(&slot->value, std::move(value));
+                    slot->key.store(key, std::memory_order_release);
+                    this->count++;
+                }
+
+                /// Remove an object or release a reserved key
+                /**
+                 *  @param key: key of the object
+                 *  @return the object or an empty pointer if the key is stale
+                 */
+                std::shared_ptr<T> erase(Key const key) {
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    auto slot = (key != INVALID) ? this->at(key) : NULL;
+                    auto index = std::size_t(key & (CAPACITY - 1));
+                    if (slot == NULL || !slot->taken
+                        || build(slot->generation, index) != key) {
+                        return std::shared_ptr<T>();
+                    }
+                    if (slot->key.load() == key) {
+                        this->count--;
+                    }
+                    slot->key.store(INVALID, std::memory_order_release);
+                    auto value = std::atomic_exchange(&slot->value,
+                                                      std::shared_ptr<T>());
+                    slot->generation++;
+                    slot->taken = false;
+                    if (slot->generation < GENERATIONS) {
+                        this->unused.push_back(index);
+                    }
+                    // Otherwise the slot is retired, so its keys are not
+                    // handed out again
+                    return value;
+                }
+
+                /// Replace the object of a key
+                /**
+                 * The key stays valid and refers to the new object.
+                 *  @param key: key of the object
+                 *  @param value: new object
+                 *  @return the old object or an empty pointer if the key is
+                 *      stale
+                 */
+                std::shared_ptr<T> replace(Key const key,
+                                           std::shared_ptr<T> value) {
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    auto slot = (key != INVALID) ? this->at(key) : NULL;
+                    if (slot == NULL || slot->key.load() != key) {
+                        return std::shared_ptr<T>();
+                    }
+                    return std::atomic_exchange(&slot->value,
+                                                std::move(value));
+                }
+
+                /// Find an object without locking
+                /**
+                 *  @param key: key of the object
+                 *  @return the object or an empty pointer
+                 */
+                std::shared_ptr<T> find(Key const key) const {
+                    auto slot = (key != INVALID) ? this->at(key) : NULL;
+                    if (slot == NULL
+                        || slot->key.load(std::memory_order_acquire) != key) {
+                        return std::shared_ptr<T>();
+                    }
+                    auto value = std::atomic_load(&slot->value);
+                    if (slot->key.load(std::memory_order_acquire) != key) {
+                        // slot was reused in the meantime
+                        return std::shared_ptr<T>();
+                    }
+                    return value;
+                }
+
+                /// Call a function for each object without locking
+                /**
+                 * Objects that are inserted or erased meanwhile might be
+                 *  skipped or visited.
+                 *  @param function: called with key and object
+                 */
+                template <typename Function>
+                void forEach(Function function) const {
+                    auto n = this->used.load(std::memory_order_acquire);
+                    for (std::size_t i = 0; i < n; i++) {
+                        auto slot = this->at(i);
+                        auto key = slot->key.load(std::memory_order_acquire);
+                        if (key == INVALID) {
+                            continue;
+                        }
+                        auto value = std::atomic_load(&slot->value);
+                        if (value != NULL && slot->key.load(
+                                std::memory_order_acquire) == key) {
+                            function(key, value);
+                        }
+                    }
+                }
+
+                /// Returns the number of objects
+                inline std::size_t size() const {
+                    return this->count.load();
+                }
+        };
+
+    }
+
+}
+
+#endif // NET_SLOTMAP_INCLUDE_GUARD
@@ -0,0 +1,209 @@
+/*
+Copyright (c) 2013 Christian Glöckner <cgloeckner@freenet.de>
+
+This file is part of the networking module:
+    https://github.com/cgloeckner/networking
+
+It offers a tcp-based server-client framework for games and other software.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#ifndef NET_SOCKET_INCLUDE_GUARD
+#define NET_SOCKET_INCLUDE_GUARD
+
+#include <vector>
+#include <cerrno>
+#include <cstdint>
+
+#include <SFML/Network.hpp>
+
+#include <net/poller.hpp>
+#include <net/frame.hpp>
+
+// Multiple frames are written by a single gather-write on POSIX systems
+// unless NET_NO_WRITEV is defined. Other platforms send frame by frame.
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(NET_NO_WRITEV)
+#define NET_USE_WRITEV
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <limits.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
+namespace net {
+
+    namespace utils {
+
+        /// Maximum number of frames written at once
+#if defined(NET_USE_WRITEV) && defined(IOV_MAX)
+        std::size_t const MAX_BATCH = IOV_MAX / 2;
+#else
+        std::size_t const MAX_BATCH = 1024;
+#endif
+
+        /// Enable or disable Nagle's algorithm of a TCP socket
+        /**
+         * SFML disables Nagle's algorithm for all TCP sockets. Enabling it
+         *  again trades latency for fewer, larger TCP segments. This is only
+         *  supported on POSIX systems and ignored elsewhere.
+         *  @param link: connected TCP socket
+         *  @param enabled: true to send data without delay (SFML's default)
+         */
+        inline void setNoDelay(sf::TcpSocket & link, bool const enabled) {
+#if defined(__unix__) || defined(__APPLE__)
+            int flag = enabled ? 1 : 0;
+            ::setsockopt(getHandle(link), IPPROTO_TCP, TCP_NODELAY, &flag,
+                         sizeof(flag));
+#else
+            (void)link;
+            (void)enabled;
+#endif
+        }
+
+        /// Cork or uncork a TCP socket
+        /**
+         * While a socket is corked, only full TCP segments are sent.
+         *  Uncorking it sends the remaining data immediately. This uses
+         *  TCP_CORK on Linux and TCP_NOPUSH on BSD systems and is ignored
+         *  elsewhere.
+         *  @param link: connected TCP socket
+         *  @param corked: true to cork, false to uncork
+         */
+        inline void setCork(sf::TcpSocket & link, bool const corked) {
+            int flag = corked ? 1 : 0;
+#if defined(TCP_CORK)
+            ::setsockopt(getHandle(link), IPPROTO_TCP, TCP_CORK, &flag,
+                         sizeof(flag));
+#elif defined(TCP_NOPUSH)
+            ::setsockopt(getHandle(link), IPPROTO_TCP, TCP_NOPUSH, &flag,
+                         sizeof(flag));
+#else
+            (void)link;
+            (void)flag;
+#endif
+        }
+
+        /// Send a sequence of frames
+        /**
+         * Sends the given frames, starting `offset` bytes inside the first
+         *  one. With NET_USE_WRITEV all frames are handed to the kernel by a
+         *  single gather-write. The number of bytes that were sent is
+         *  returned by `sent`, also if not everything could be sent.
+         *  @param link: non-blocking TCP socket
+         *  @param begin: iterator to the first frame
+         *  @param end: iterator behind the last frame
+         *  @param offset: number of bytes of the first frame already sent
+         *  @param sent: number of bytes sent by this call
+         *  @return Done if everything was sent, Partial or NotReady if the
+         *      socket is busy, otherwise an error status
+         */
+        template <typename Iterator>
+        sf::Socket::Status sendFrames(sf::TcpSocket & link, Iterator begin,
+                                      Iterator end, std::size_t offset,
+                                      std::size_t & sent) {
+            sent = 0;
+#ifdef NET_USE_WRITEV
+            // Reused buffer of the calling (network) thread
+            static thread_local std::vector<iovec> buffers;
+            buffers.clear();
+            std::size_t total = 0;
+            for (auto frame = begin; frame != end; frame++) {
+                // Header and data are separate buffers
+                total += (*frame)->size() - offset;
+                iovec buffer;
+                if (offset < Frame::HEADER) {
+                    buffer.iov_base = const_cast<char*>(
+                        (*frame)->header() + offset);
+                    buffer.iov_len = Frame::HEADER - offset;
+                    buffers.push_back(buffer);
+                    offset = Frame::HEADER;
+                }
+                buffer.iov_base = const_cast<char*>(
+                    (*frame)->data() + offset - Frame::HEADER);
+                buffer.iov_len = (*frame)->size() - offset;
+                if (buffer.iov_len > 0) {
+                    buffers.push_back(buffer);
+                }
+                offset = 0;
+            }
+            if (buffers.empty()) {
+                return sf::Socket::Done;
+            }
+            msghdr message = msghdr();
+            message.msg_iov = buffers.data();
+            message.msg_iovlen = buffers.size();
+#ifdef MSG_NOSIGNAL
+            int const flags = MSG_NOSIGNAL;
+#else
+            int const flags = 0;
+#endif
+            ssize_t result;
+            do {
+                result = ::sendmsg(getHandle(link), &message, flags);
+            } while (result == -1 && errno == EINTR);
+            if (result == -1) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    return sf::Socket::NotReady;
+                }
+                if (errno == ECONNRESET || errno == EPIPE
+                    || errno == ENOTCONN || errno == ETIMEDOUT) {
+                    return sf::Socket::Disconnected;
+                }
+                return sf::Socket::Error;
+            }
+            sent = std::size_t(result);
+            return (sent == total) ? sf::Socket::Done : sf::Socket::Partial;
+#else
+            for (auto frame = begin; frame != end; frame++) {
+                std::size_t done = 0;
+                auto status = sf::Socket::Done;
+                if (offset < Frame::HEADER) {
+                    // Send (the rest of) the header
+                    status = link.send((*frame)->header() + offset,
+                                       Frame::HEADER - offset, done);
+                    sent += done;
+                    offset += done;
+                }
+                if (status == sf::Socket::Done
+                    && offset < (*frame)->size()) {
+                    status = link.send(
+                        (*frame)->data() + offset - Frame::HEADER,
+                        (*frame)->size() - offset, done);
+                    sent += done;
+                }
+                offset = 0;
+                if (status != sf::Socket::Done) {
+                    return status;
+                }
+            }
+            return sf::Socket::Done;
+#endif
+        }
+
+    }
+
+}
+
+#endif // NET_SOCKET_INCLUDE_GUARD
@@ -0,0 +1,339 @@
+/*
+Copyright (c) 2013 Christian Glöckner <cgloeckner@freenet.de>
+
+This file is part of the networking module:
+    https://github.com/cgloeckner/networking
+
+It offers a tcp-based server-client framework for games and other software.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#ifndef NET_STATS_INCLUDE_GUARD
+#define NET_STATS_INCLUDE_GUARD
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <ostream>
+#include <cstdint>
+
+#include <net/common.hpp>
+#include <net/callbacks.hpp>
+#include <net/profile.hpp>
+
+namespace net {
+
+    /// Traffic of a single link
+    struct LinkStats {
+        /// received objects
+        std::uint64_t messages_in;
+        /// received bytes
+        std::uint64_t bytes_in;
+        /// sent objects
+        std::uint64_t messages_out;
+        /// sent bytes
+        std::uint64_t bytes_out;
+        /// bytes waiting for sending
+        std::uint64_t queued;
+
+        LinkStats()
+            : messages_in(0)
+            , bytes_in(0)
+            , messages_out(0)
+            , bytes_out(0)
+            , queued(0) {
+        }
+    };
+
+    /// Callback executions of a single command
+    struct CommandStats {
+        /// number of calls
+        std::uint64_t calls;
+        /// total execution time in nanoseconds
+        std::uint64_t nanos;
+
+        CommandStats()
+            : calls(0)
+            , nanos(0) {
+        }
+    };
+
+    /// Snapshot of a server's statistics
+    /**
+     * All counters increase monotonically, so rates are obtained by
+     *  comparing two snapshots using their `time`.
+     */
+    struct ServerStats {
+        /// time of the snapshot (nanoseconds, see utils::now)
+        std::uint64_t time;
+        /// connected clients
+        std::size_t clients;
+        /// accepted connections
+        std::uint64_t accepted;
+        /// refused connections (full, banned or no ID left)
+        std::uint64_t refused;
+        /// disconnected clients
+        std::uint64_t disconnected;
+        /// sessions that were resumed after their links were lost
+        std::uint64_t resumed;
+        /// outgoing objects that were dropped (overflow or disconnect)
+        std::uint64_t dropped;
+        /// received objects waiting for a handler
+        std::size_t incoming;
+        /// pushed objects waiting for sending (one per client)
+        std::size_t outgoing;
+        /// traffic of all clients (including disconnected ones)
+        LinkStats total;
+        /// traffic of each connected client
+        std::map<ClientID, LinkStats> links;
+        /// callback executions per command
+        std::map<CommandID, CommandStats> commands;
+
+        ServerStats()
+            : time(0)
+            , clients(0)
+            , accepted(0)
+            , refused(0)
+            , disconnected(0)
+            , resumed(0)
+            , dropped(0)
+            , incoming(0)
+            , outgoing(0) {
+        }
+    };
+
+    /// Snapshot of a client's statistics
+    struct ClientStats {
+        /// time of the snapshot (nanoseconds, see utils::now)
+        std::uint64_t time;
+        /// received objects waiting for the handler
+        std::size_t incoming;
+        /// pushed objects waiting for sending
+        std::size_t outgoing;
+        /// traffic to and from the server
+        LinkStats link;
+        /// callback executions per command
+        std::map<CommandID, CommandStats> commands;
+
+        ClientStats()
+            : time(0)
+            , incoming(0)
+            , outgoing(0) {
+        }
+    };
+
+    namespace utils {
+
+        /// Traffic counters of a link (updated by a single thread)
+        struct LinkCounters {
+            std::atomic<std::uint64_t> messages_in;
+            std::atomic<std::uint64_t> bytes_in;
+            std::atomic<std::uint64_t> messages_out;
+            std::atomic<std::uint64_t> bytes_out;
+
+            LinkCounters()
+                : messages_in(0)
+                , bytes_in(0)
+                , messages_out(0)
+                , bytes_out(0) {
+            }
+
+            /// Count a received object
+            inline void receive(std::size_t const bytes) {
+                this->messages_in.fetch_add(1, std::memory_order_relaxed);
+                this->bytes_in.fetch_add(bytes, std::memory_order_relaxed);
+            }
+
+            /// Count a sent object
+            inline void send(std::size_t const bytes) {
+                this->messages_out.fetch_add(1, std::memory_order_relaxed);
+                this->bytes_out.fetch_add(bytes, std::memory_order_relaxed);
+            }
+
+            /// Add the counters of another link (e.g. of a resumed session)
+            void add(LinkCounters const & other) {
+                this->messages_in.fetch_add(other.messages_in.load(
+                    std::memory_order_relaxed), std::memory_order_relaxed);
+                this->bytes_in.fetch_add(other.bytes_in.load(
+                    std::memory_order_relaxed), std::memory_order_relaxed);
+                this->messages_out.fetch_add(other.messages_out.load(
+                    std::memory_order_relaxed), std::memory_order_relaxed);
+                this->bytes_out.fetch_add(other.bytes_out.load(
+                    std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+
+            /// Add the counters to a snapshot
+            void collect(LinkStats & stats) const {
+                stats.messages_in += this->messages_in.load(
+                    std::memory_order_relaxed);
+                stats.bytes_in += this->bytes_in.load(
+                    std::memory_order_relaxed);
+                stats.messages_out += this->messages_out.load(
+                    std::memory_order_relaxed);
+                stats.bytes_out += this->bytes_out.load(
+                    std::memory_order_relaxed);
+            }
+        };
+
+        /// Execution times of the callbacks run by a single handler thread
+        /**
+         * Commands below NET_DISPATCH_SIZE are counted by atomic arrays, all
+         *  other commands by a map (locked only for those commands).
+         */
+        class CommandTimer {
+            protected:
+                /// calls of dense commands
+                std::atomic<std::uint64_t> calls[NET_DISPATCH_SIZE];
+                /// execution times of dense commands
+                std::atomic<std::uint64_t> nanos[NET_DISPATCH_SIZE];
+                /// all other commands
+                std::map<CommandID, CommandStats> others;
+                /// mutex for the other commands
+                mutable std::mutex mutex;
+
+            public:
+                /// Constructor
+                CommandTimer() {
+                    for (std::size_t i = 0; i < NET_DISPATCH_SIZE; i++) {
+                        this->calls[i].store(0, std::memory_order_relaxed);
+                        this->nanos[i].store(0, std::memory_order_relaxed);
+                    }
+                }
+
+                /// Count a callback execution
+                /**
+                 *  @param command: command of the handled object
+                 *  @param ns: execution time in nanoseconds
+                 */
+                inline void record(CommandID const command,
+                                   std::uint64_t const ns) {
+                    if (command < NET_DISPATCH_SIZE) {
+                        this->calls[command].fetch_add(1,
+                            std::memory_order_relaxed);
+                        this->nanos[command].fetch_add(ns,
+                            std::memory_order_relaxed);
+                        return;
+                    }
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    auto & stats = this->others[command];
+                    stats.calls++;
+                    stats.nanos += ns;
+                }
+
+                /// Returns the number of executed callbacks
+                std::uint64_t count() const {
+                    std::uint64_t n = 0;
+                    for (std::size_t i = 0; i < NET_DISPATCH_SIZE; i++) {
+                        n += this->calls[i].load(std::memory_order_relaxed);
+                    }
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    for (auto node = this->others.begin();
+                         node != this->others.end(); node++) {
+                        n += node->second.calls;
+                    }
+                    return n;
+                }
+
+                /// Add the counters to a snapshot
+                void collect(std::map<CommandID, CommandStats> & stats) const {
+                    for (std::size_t i = 0; i < NET_DISPATCH_SIZE; i++) {
+                        auto n = this->calls[i].load(std::memory_order_relaxed);
+                        if (n > 0) {
+                            auto & entry = stats[CommandID(i)];
+                            entry.calls += n;
+                            entry.nanos += this->nanos[i].load(
+                                std::memory_order_relaxed);
+                        }
+                    }
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    for (auto node = this->others.begin();
+                         node != this->others.end(); node++) {
+                        auto & entry = stats[node->first];
+                        entry.calls += node->second.calls;
+                        entry.nanos += node->second.nanos;
+                    }
+                }
+        };
+
+        /// Write the traffic of a link as text
+        inline void print(std::ostream & stream, LinkStats const & stats) {
+            stream << "in " << stats.messages_in << " msgs / "
+                   << stats.bytes_in << " bytes, out " << stats.messages_out
+                   << " msgs / " << stats.bytes_out << " bytes, queued "
+                   << stats.queued << " bytes";
+        }
+
+        /// Write the callback executions as text
+        inline void print(std::ostream & stream,
+                          std::map<CommandID, CommandStats> const & commands) {
+            for (auto node = commands.begin(); node != commands.end(); node++) {
+                stream << "  command #" << node->first << ": "
+                       << node->second.calls << " calls, "
+                       << node->second.nanos / 1000 << " us total";
+                if (node->second.calls > 0) {
+                    stream << ", " << node->second.nanos / node->second.calls
+                           << " ns avg";
+                }
+                stream << "\n";
+            }
+        }
+
+    }
+
+    /// Write a server's statistics as text
+    inline std::ostream & operator<<(std::ostream & stream,
+                                     ServerStats const & stats) {
+        stream << "clients: " << stats.clients << " connected, "
+               << stats.accepted << " accepted, " << stats.refused
+               << " refused, " << stats.disconnected << " disconnected, "
+               << stats.resumed << " resumed\n"
+               << "queues: " << stats.incoming << " incomming, "
+               << stats.outgoing << " outgoing, " << stats.dropped
+               << " dropped\n"
+               << "traffic: ";
+        utils::print(stream, stats.total);
+        stream << "\n";
+        for (auto node = stats.links.begin(); node != stats.links.end();
+             node++) {
+            stream << "  client #" << node->first << ": ";
+            utils::print(stream, node->second);
+            stream << "\n";
+        }
+        stream << "callbacks:\n";
+        utils::print(stream, stats.commands);
+        return stream;
+    }
+
+    /// Write a client's statistics as text
+    inline std::ostream & operator<<(std::ostream & stream,
+                                     ClientStats const & stats) {
+        stream << "queues: " << stats.incoming << " incomming, "
+               << stats.outgoing << " outgoing\n"
+               << "traffic: ";
+        utils::print(stream, stats.link);
+        stream << "\ncallbacks:\n";
+        utils::print(stream, stats.commands);
+        return stream;
+    }
+
+}
+
+#endif // NET_STATS_INCLUDE_GUARD
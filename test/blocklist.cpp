@@ -0,0 +1,134 @@
+/*
+Copyright (c) 2013 Christian Glöckner <cgloeckner@freenet.de>
+
+This file is part of the networking module:
+    https://github.com/cgloeckner/networking
+
+It offers a tcp-based server-client framework for games and other software.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include <net/blocklist.hpp>
+
+#include "check.hpp"
+
+/// Exposes the lookup table of a blocklist
+class BlocklistProbe: public net::utils::Blocklist {
+    public:
+        inline std::size_t ranges() const {
+            return std::atomic_load(&this->table)->size();
+        }
+};
+
+/// Returns whether the text is parsed into the given range
+bool parse(std::string const & text, net::utils::Address const & first,
+           net::utils::Address const & last) {
+    net::utils::AddressRange range;
+    return (net::utils::parseRange(text, range) && range.first == first
+            && range.last == last);
+}
+
+void testParseRange() {
+    using net::utils::Address;
+    net::utils::AddressRange range;
+    // Prefix length 0 covers the whole address family
+    CHECK(parse("::/0", Address(0, 0), Address(~0ull, ~0ull)));
+    CHECK(parse("0.0.0.0/0", Address::fromIPv4(0),
+                Address::fromIPv4(0xFFFFFFFFu)));
+    CHECK(parse("10.1.2.3/0", Address::fromIPv4(0),
+                Address::fromIPv4(0xFFFFFFFFu)));
+    // Full prefix length covers a single address
+    CHECK(parse("2001:db8::1/128", Address(0x20010DB800000000ull, 1),
+                Address(0x20010DB800000000ull, 1)));
+    CHECK(parse("ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff/128",
+                Address(~0ull, ~0ull), Address(~0ull, ~0ull)));
+    CHECK(parse("10.1.2.3/32", Address::fromIPv4(0x0A010203u),
+                Address::fromIPv4(0x0A010203u)));
+    // Prefix lengths at the 64 bit boundary
+    CHECK(parse("2001:db8::1/64", Address(0x20010DB800000000ull, 0),
+                Address(0x20010DB800000000ull, ~0ull)));
+    CHECK(parse("2001:db8::1/63", Address(0x20010DB800000000ull, 0),
+                Address(0x20010DB800000001ull, ~0ull)));
+    // Invalid prefixes
+    CHECK(!net::utils::parseRange("::/129", range));
+    CHECK(!net::utils::parseRange("10.0.0.0/33", range));
+    CHECK(!net::utils::parseRange("10.0.0.0/", range));
+    CHECK(!net::utils::parseRange("10.0.0.0/8x", range));
+    CHECK(!net::utils::parseRange("::g", range));
+}
+
+void testBlocklist() {
+    using net::utils::Address;
+    {
+        // Adjacent ranges are merged into one
+        BlocklistProbe list;
+        std::vector<std::string> texts = {"10.0.0.128/25", "10.0.0.0/25",
+                                          "10.0.1.0"};
+        CHECK(list.insert(texts.begin(), texts.end()) == 3);
+        CHECK(list.ranges() == 1);
+        CHECK(list.contains(Address::fromIPv4(0x0A000000u)));
+        CHECK(list.contains(Address::fromIPv4(0x0A000100u)));
+        CHECK(!list.contains(Address::fromIPv4(0x0A000101u)));
+        CHECK(!list.contains(Address::fromIPv4(0x09FFFFFFu)));
+        // Removing an entry splits the merged range again
+        std::vector<std::string> removed = {"10.0.0.128/25"};
+        CHECK(list.erase(removed.begin(), removed.end()) == 1);
+        CHECK(list.ranges() == 2);
+        CHECK(!list.contains(Address::fromIPv4(0x0A000080u)));
+    }
+    {
+        // Ranges that are not adjacent are kept apart
+        BlocklistProbe list;
+        std::vector<std::string> texts = {"10.0.0.0/25", "10.0.0.129"};
+        list.insert(texts.begin(), texts.end());
+        CHECK(list.ranges() == 2);
+        CHECK(!list.contains(Address::fromIPv4(0x0A000080u)));
+    }
+    {
+        // Ranges touching the end of the address space do not wrap around
+        BlocklistProbe list;
+        std::vector<std::string> texts = {"::/1", "8000::/1", "::1"};
+        list.insert(texts.begin(), texts.end());
+        CHECK(list.ranges() == 1);
+        CHECK(list.contains(Address(0, 0)));
+        CHECK(list.contains(Address(~0ull, ~0ull)));
+    }
+    {
+        // Nested and duplicated ranges
+        BlocklistProbe list;
+        std::vector<std::string> texts = {"0.0.0.0/0", "10.0.0.0/8",
+                                          "10.0.0.0/8"};
+        list.insert(texts.begin(), texts.end());
+        CHECK(list.ranges() == 1);
+        CHECK(list.contains(Address::fromIPv4(0xFFFFFFFFu)));
+        CHECK(!list.contains(Address(0, 1)));
+    }
+}
+
+int main() {
+    testParseRange();
+    testBlocklist();
+    return report();
+}
@@ -0,0 +1,69 @@
+/*
+Copyright (c) 2013 Christian Glöckner <cgloeckner@freenet.de>
+
+This file is part of the networking module:
+    https://github.com/cgloeckner/networking
+
+It offers a tcp-based server-client framework for games and other software.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <limits>
+#include <cstdint>
+
+#include <net/profile.hpp>
+
+#include "check.hpp"
+
+/// Exposes the bucket mapping of a histogram
+class HistogramProbe: public net::utils::Histogram {
+    public:
+        using net::utils::Histogram::indexOf;
+        using net::utils::Histogram::valueOf;
+};
+
+void testHistogram() {
+    auto const max = std::numeric_limits<std::uint64_t>::max();
+    auto top = HistogramProbe::indexOf(max);
+    CHECK(top < HistogramProbe::BUCKETS);
+    CHECK(HistogramProbe::valueOf(top) == max);
+    CHECK(HistogramProbe::indexOf(max - 1) == top);
+    CHECK(HistogramProbe::indexOf(std::uint64_t(1) << 63) <= top);
+    // Each bucket ends right before the next one starts
+    for (std::size_t i = 0; i < top; i++) {
+        auto value = HistogramProbe::valueOf(i);
+        CHECK(HistogramProbe::indexOf(value) == i);
+        CHECK(HistogramProbe::indexOf(value + 1) == i + 1);
+    }
+    // Recording the highest value does not overflow
+    HistogramProbe histogram;
+    histogram.record(max);
+    histogram.record(0);
+    CHECK(histogram.count() == 2);
+    CHECK(histogram.max() == max);
+    CHECK(histogram.percentile(1.0) == max);
+    CHECK(histogram.percentile(0.0) == 0);
+}
+
+int main() {
+    testHistogram();
+    return report();
+}
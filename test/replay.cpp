@@ -0,0 +1,71 @@
+/*
+Copyright (c) 2013 Christian Glöckner <cgloeckner@freenet.de>
+
+This file is part of the networking module:
+    https://github.com/cgloeckner/networking
+
+It offers a tcp-based server-client framework for games and other software.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <memory>
+
+#include <net/session.hpp>
+
+#include "check.hpp"
+
+void testReplayBuffer() {
+    auto frame = std::make_shared<net::utils::Frame const>();
+    net::utils::ReplayBuffer buffer(8);
+    // Sequence numbers wrap around while frames are kept
+    buffer.reset(0xFFFFFFFEu);
+    for (std::size_t i = 0; i < 4; i++) {
+        buffer.push(frame);
+    }
+    CHECK(buffer.size() == 4);
+    // Stale acknowledgements are ignored
+    buffer.acknowledge(0xFFFFFFF0u);
+    CHECK(buffer.size() == 4);
+    CHECK(buffer.base() == 0xFFFFFFFEu);
+    buffer.acknowledge(0xFFFFFFFFu);
+    CHECK(buffer.size() == 3);
+    CHECK(buffer.base() == 0xFFFFFFFFu);
+    // Acknowledging across the wrap drops the frames before it
+    buffer.acknowledge(1u);
+    CHECK(buffer.size() == 1);
+    CHECK(buffer.base() == 1u);
+    // Acknowledging more than was sent drops everything
+    buffer.acknowledge(10u);
+    CHECK(buffer.size() == 0);
+    // Dropping the oldest frame when full also wraps around
+    net::utils::ReplayBuffer small(2);
+    small.reset(0xFFFFFFFFu);
+    small.push(frame);
+    small.push(frame);
+    small.push(frame);
+    CHECK(small.size() == 2);
+    CHECK(small.base() == 0u);
+}
+
+int main() {
+    testReplayBuffer();
+    return report();
+}
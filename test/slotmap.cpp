@@ -0,0 +1,62 @@
+/*
+Copyright (c) 2013 Christian Glöckner <cgloeckner@freenet.de>
+
+This file is part of the networking module:
+    https://github.com/cgloeckner/networking
+
+It offers a tcp-based server-client framework for games and other software.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <set>
+#include <memory>
+
+#include <net/slotmap.hpp>
+
+#include "check.hpp"
+
+void testSlotMap() {
+    typedef net::utils::SlotMap<int> Map;
+    Map map;
+    std::set<Map::Key> keys;
+    // Reusing a single slot exhausts all of its generations
+    auto rounds = std::size_t(Map::GENERATIONS) * 2 + 10;
+    for (std::size_t i = 0; i < rounds; i++) {
+        auto key = map.reserve();
+        CHECK(key != Map::INVALID);
+        CHECK(keys.insert(key).second);
+        map.insert(key, std::make_shared<int>(int(i)));
+        CHECK(map.find(key) != NULL);
+        CHECK(map.erase(key) != NULL);
+        CHECK(map.find(key) == NULL);
+        // Stale keys stay stale
+        CHECK(map.erase(key) == NULL);
+    }
+    CHECK(keys.size() == rounds);
+    // The first slots were retired after their last generation
+    CHECK(map.find(Map::Key(0)) == NULL);
+    CHECK(map.size() == 0);
+}
+
+int main() {
+    testSlotMap();
+    return report();
+}